@@ -179,8 +179,64 @@ void Allocator::free(uint8_t* address, size_t size) {
     return internal_free(address, size);
 }
 
+std::expected<uint8_t*, Allocator::Error> Allocator::reserve(
+    const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
+    std::scoped_lock lock{m_mutex};
+
+    auto reservation_size = align_up(size, system_info().allocation_granularity);
+    auto reservation_address = allocate_nearby_memory(desired_addresses, reservation_size, max_distance);
+
+    if (!reservation_address) {
+        return std::unexpected{reservation_address.error()};
+    }
+
+    if (m_sealed) {
+        vm_protect(*reservation_address, reservation_size, VM_ACCESS_RX);
+    }
+
+    // Searched first by internal_allocate_near.
+    auto& reservation = *m_memory.emplace(m_memory.begin(), new Memory);
+
+    reservation->address = *reservation_address;
+    reservation->size = reservation_size;
+    reservation->freelist = std::make_unique<FreeNode>();
+    reservation->freelist->start = *reservation_address;
+    reservation->freelist->end = *reservation_address + reservation_size;
+
+    return *reservation_address;
+}
+
+bool Allocator::seal() {
+    std::scoped_lock lock{m_mutex};
+    return internal_protect(false);
+}
+
+bool Allocator::unseal() {
+    std::scoped_lock lock{m_mutex};
+    return internal_protect(true);
+}
+
+bool Allocator::internal_protect(bool writable) {
+    bool success = true;
+
+    for (const auto& allocation : m_memory) {
+        if (!vm_protect(allocation->address, allocation->size, writable ? VM_ACCESS_RWX : VM_ACCESS_RX)) {
+            success = false;
+        }
+    }
+
+    m_sealed = !writable;
+
+    return success;
+}
+
 std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_near(
     const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
+    // Whatever is allocated is about to be written to.
+    if (m_sealed) {
+        internal_protect(true);
+    }
+
     // First search through our list of allocations for a free block that is large
     // enough.
     for (const auto& allocation : m_memory) {
@@ -508,21 +564,89 @@ constexpr auto make_jmp_e9(uint8_t* src, uint8_t* dst) {
     return {};
 }
 
-static bool decode(ZydisDecodedInstruction* ix, uint8_t* ip) {
+namespace {
+// The decoder only depends on the machine mode, so each thread initializes one and keeps it.
+struct Decoder {
     ZydisDecoder decoder{};
-    ZyanStatus status;
+    bool initialized{};
 
+    Decoder() {
 #if SAFETYHOOK_ARCH_X86_64
-    status = ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+        initialized = ZYAN_SUCCESS(ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64));
 #elif SAFETYHOOK_ARCH_X86_32
-    status = ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32);
+        initialized = ZYAN_SUCCESS(ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32));
 #endif
+    }
+};
 
-    if (!ZYAN_SUCCESS(status)) {
+// Instructions at the start of a hook target. Decoded once per hook and shared by the analysis and relocation passes
+// of e9_hook and by ff_hook. The storage belongs to the thread and is reused by every hook it creates.
+struct Prologue {
+    uint8_t* target{};
+    size_t size{}; // Bytes covered by instructions.
+    std::vector<ZydisDecodedInstruction> instructions{};
+};
+} // namespace
+
+static const Decoder& thread_decoder() {
+    thread_local const Decoder decoder{};
+    return decoder;
+}
+
+static bool decode(ZydisDecodedInstruction* ix, uint8_t* ip) {
+    const auto& decoder = thread_decoder();
+
+    if (!decoder.initialized) {
         return false;
     }
 
-    return ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&decoder, nullptr, ip, 15, ix));
+    return ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&decoder.decoder, nullptr, ip, 15, ix));
+}
+
+bool decode_full(ZydisDecodedInstruction* ix, ZydisDecodedOperand* operands, uint8_t* ip) {
+    const auto& decoder = thread_decoder();
+
+    if (!decoder.initialized) {
+        return false;
+    }
+
+    return ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder.decoder, ip, ZYDIS_MAX_INSTRUCTION_LENGTH, ix, operands));
+}
+
+static Prologue& thread_prologue() {
+    thread_local Prologue prologue{};
+    return prologue;
+}
+
+// Forget what was decoded, the bytes at a target may have changed since.
+static void reset_prologue(uint8_t* target) {
+    auto& prologue = thread_prologue();
+    prologue.target = target;
+    prologue.size = 0;
+    prologue.instructions.clear();
+}
+
+// Decodes whole instructions from the target until at least size bytes are covered, continuing after what an earlier
+// call for the same hook already decoded. Returns the address that failed to decode on error.
+static std::expected<const Prologue*, uint8_t*> decode_prologue(uint8_t* target, size_t size) {
+    auto& prologue = thread_prologue();
+
+    if (prologue.target != target) {
+        reset_prologue(target);
+    }
+
+    while (prologue.size < size) {
+        auto& ix = prologue.instructions.emplace_back();
+
+        if (!decode(&ix, target + prologue.size)) {
+            prologue.instructions.pop_back();
+            return std::unexpected{target + prologue.size};
+        }
+
+        prologue.size += ix.length;
+    }
+
+    return &prologue;
 }
 
 std::expected<InlineHook, InlineHook::Error> InlineHook::create(void* target, void* destination) {
@@ -530,11 +654,11 @@ std::expected<InlineHook, InlineHook::Error> InlineHook::create(void* target, vo
 }
 
 std::expected<InlineHook, InlineHook::Error> InlineHook::create(
-    const std::shared_ptr<Allocator>& allocator, void* target, void* destination) {
+    const std::shared_ptr<Allocator>& allocator, void* target, void* destination, Flags flags) {
     InlineHook hook{};
 
     if (const auto setup_result =
-            hook.setup(allocator, reinterpret_cast<uint8_t*>(target), reinterpret_cast<uint8_t*>(destination));
+            hook.setup(allocator, reinterpret_cast<uint8_t*>(target), reinterpret_cast<uint8_t*>(destination), flags);
         !setup_result) {
         return std::unexpected{setup_result.error()};
     }
@@ -557,10 +681,14 @@ InlineHook& InlineHook::operator=(InlineHook&& other) noexcept {
         m_trampoline = std::move(other.m_trampoline);
         m_trampoline_size = other.m_trampoline_size;
         m_original_bytes = std::move(other.m_original_bytes);
+        m_enabled = other.m_enabled;
+        m_type = other.m_type;
 
         other.m_target = nullptr;
         other.m_destination = nullptr;
         other.m_trampoline_size = 0;
+        other.m_enabled = false;
+        other.m_type = Type::Unset;
     }
 
     return *this;
@@ -575,9 +703,10 @@ void InlineHook::reset() {
 }
 
 std::expected<void, InlineHook::Error> InlineHook::setup(
-    const std::shared_ptr<Allocator>& allocator, uint8_t* target, uint8_t* destination) {
+    const std::shared_ptr<Allocator>& allocator, uint8_t* target, uint8_t* destination, Flags flags) {
     m_target = target;
     m_destination = destination;
+    reset_prologue(m_target);
 
     if (auto e9_result = e9_hook(allocator); !e9_result) {
 #if SAFETYHOOK_ARCH_X86_64
@@ -589,6 +718,12 @@ std::expected<void, InlineHook::Error> InlineHook::setup(
 #endif
     }
 
+    if (!(flags & StartDisabled)) {
+        if (auto enable_result = enable(); !enable_result) {
+            return enable_result;
+        }
+    }
+
     return {};
 }
 
@@ -597,11 +732,17 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
     m_trampoline_size = sizeof(TrampolineEpilogueE9);
 
     std::vector<uint8_t*> desired_addresses{m_target};
-    ZydisDecodedInstruction ix{};
+    auto prologue = decode_prologue(m_target, sizeof(JmpE9));
+
+    if (!prologue) {
+        return std::unexpected{Error::failed_to_decode_instruction(prologue.error())};
+    }
+
+    auto ip = m_target;
 
-    for (auto ip = m_target; ip < m_target + sizeof(JmpE9); ip += ix.length) {
-        if (!decode(&ix, ip)) {
-            return std::unexpected{Error::failed_to_decode_instruction(ip)};
+    for (const auto& ix : (*prologue)->instructions) {
+        if (ip >= m_target + sizeof(JmpE9)) {
+            break;
         }
 
         m_trampoline_size += ix.length;
@@ -628,6 +769,8 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
                 return std::unexpected{Error::unsupported_instruction_in_trampoline(ip)};
             }
         }
+
+        ip += ix.length;
     }
 
     auto trampoline_allocation = allocator->allocate_near(desired_addresses, m_trampoline_size);
@@ -638,10 +781,12 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
 
     m_trampoline = std::move(*trampoline_allocation);
 
-    for (auto ip = m_target, tramp_ip = m_trampoline.data(); ip < m_target + m_original_bytes.size(); ip += ix.length) {
-        if (!decode(&ix, ip)) {
-            m_trampoline.free();
-            return std::unexpected{Error::failed_to_decode_instruction(ip)};
+    ip = m_target;
+    auto tramp_ip = m_trampoline.data();
+
+    for (const auto& ix : (*prologue)->instructions) {
+        if (ip >= m_target + m_original_bytes.size()) {
+            break;
         }
 
         const auto is_relative = (ix.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
@@ -687,6 +832,8 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
             std::copy_n(ip, ix.length, tramp_ip);
             tramp_ip += ix.length;
         }
+
+        ip += ix.length;
     }
 
     auto trampoline_epilogue = reinterpret_cast<TrampolineEpilogueE9*>(
@@ -716,26 +863,8 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
     }
 #endif
 
-    std::optional<Error> error;
-
-    // jmp from original to trampoline.
-    execute_while_frozen(
-        [this, &trampoline_epilogue, &error] {
-            if (auto result = emit_jmp_e9(m_target,
-                    reinterpret_cast<uint8_t*>(&trampoline_epilogue->jmp_to_destination), m_original_bytes.size());
-                !result) {
-                error = result.error();
-            }
-        },
-        [this](auto, auto, auto ctx) {
-            for (size_t i = 0; i < m_original_bytes.size(); ++i) {
-                fix_ip(ctx, m_target + i, m_trampoline.data() + i);
-            }
-        });
-
-    if (error) {
-        return std::unexpected{*error};
-    }
+    // The jmp from original to trampoline is written by enable().
+    m_type = Type::E9;
 
     return {};
 }
@@ -744,11 +873,19 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
 std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr<Allocator>& allocator) {
     m_original_bytes.clear();
     m_trampoline_size = sizeof(TrampolineEpilogueFF);
-    ZydisDecodedInstruction ix{};
 
-    for (auto ip = m_target; ip < m_target + sizeof(JmpFF) + sizeof(uintptr_t); ip += ix.length) {
-        if (!decode(&ix, ip)) {
-            return std::unexpected{Error::failed_to_decode_instruction(ip)};
+    // Picks up where e9_hook's decoding stopped.
+    auto prologue = decode_prologue(m_target, sizeof(JmpFF) + sizeof(uintptr_t));
+
+    if (!prologue) {
+        return std::unexpected{Error::failed_to_decode_instruction(prologue.error())};
+    }
+
+    auto ip = m_target;
+
+    for (const auto& ix : (*prologue)->instructions) {
+        if (ip >= m_target + sizeof(JmpFF) + sizeof(uintptr_t)) {
+            break;
         }
 
         // We can't support any instruction that is IP relative here because
@@ -760,6 +897,7 @@ std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr
 
         m_original_bytes.insert(m_original_bytes.end(), ip, ip + ix.length);
         m_trampoline_size += ix.length;
+        ip += ix.length;
     }
 
     auto trampoline_allocation = allocator->allocate(m_trampoline_size);
@@ -784,15 +922,48 @@ std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr
         return std::unexpected{result.error()};
     }
 
+    // The jmp from original to destination is written by enable().
+    m_type = Type::FF;
+
+    return {};
+}
+#endif
+
+std::expected<void, InlineHook::Error> InlineHook::enable() {
+    std::scoped_lock lock{m_mutex};
+
+    if (m_enabled) {
+        return {};
+    }
+
+    if (!m_trampoline) {
+        return std::unexpected{Error::not_enough_space(m_target)};
+    }
+
     std::optional<Error> error;
 
     // jmp from original to trampoline.
     execute_while_frozen(
         [this, &error] {
-            if (auto result = emit_jmp_ff(m_target, m_destination, m_target + sizeof(JmpFF), m_original_bytes.size());
-                !result) {
-                error = result.error();
+            if (m_type == Type::E9) {
+                auto trampoline_epilogue = reinterpret_cast<TrampolineEpilogueE9*>(
+                    m_trampoline.address() + m_trampoline_size - sizeof(TrampolineEpilogueE9));
+
+                if (auto result = emit_jmp_e9(m_target,
+                        reinterpret_cast<uint8_t*>(&trampoline_epilogue->jmp_to_destination), m_original_bytes.size());
+                    !result) {
+                    error = result.error();
+                }
             }
+#if SAFETYHOOK_ARCH_X86_64
+            else if (m_type == Type::FF) {
+                if (auto result =
+                        emit_jmp_ff(m_target, m_destination, m_target + sizeof(JmpFF), m_original_bytes.size());
+                    !result) {
+                    error = result.error();
+                }
+            }
+#endif
         },
         [this](auto, auto, auto ctx) {
             for (size_t i = 0; i < m_original_bytes.size(); ++i) {
@@ -804,21 +975,26 @@ std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr
         return std::unexpected{*error};
     }
 
+    m_enabled = true;
+
     return {};
 }
-#endif
 
-void InlineHook::destroy() {
+std::expected<void, InlineHook::Error> InlineHook::disable() {
     std::scoped_lock lock{m_mutex};
 
-    if (!m_trampoline) {
-        return;
+    if (!m_enabled) {
+        return {};
     }
 
+    std::optional<Error> error;
+
     execute_while_frozen(
-        [this] {
+        [this, &error] {
             if (auto um = unprotect(m_target, m_original_bytes.size())) {
                 std::copy(m_original_bytes.begin(), m_original_bytes.end(), m_target);
+            } else {
+                error = Error::failed_to_unprotect(m_target);
             }
         },
         [this](auto, auto, auto ctx) {
@@ -827,7 +1003,28 @@ void InlineHook::destroy() {
             }
         });
 
+    if (error) {
+        return std::unexpected{*error};
+    }
+
+    m_enabled = false;
+
+    return {};
+}
+
+void InlineHook::destroy() {
+    std::scoped_lock lock{m_mutex};
+
+    if (!m_trampoline) {
+        return;
+    }
+
+    if (m_enabled) {
+        (void)disable();
+    }
+
     m_trampoline.free();
+    m_type = Type::Unset;
 }
 } // namespace safetyhook
 
@@ -906,10 +1103,10 @@ std::expected<MidHook, MidHook::Error> MidHook::create(void* target, MidHookFn d
 }
 
 std::expected<MidHook, MidHook::Error> MidHook::create(
-    const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination) {
+    const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination, Flags flags) {
     MidHook hook{};
 
-    if (const auto setup_result = hook.setup(allocator, reinterpret_cast<uint8_t*>(target), destination);
+    if (const auto setup_result = hook.setup(allocator, reinterpret_cast<uint8_t*>(target), destination, flags);
         !setup_result) {
         return std::unexpected{setup_result.error()};
     }
@@ -940,7 +1137,7 @@ void MidHook::reset() {
 }
 
 std::expected<void, MidHook::Error> MidHook::setup(
-    const std::shared_ptr<Allocator>& allocator, uint8_t* target, MidHookFn destination_fn) {
+    const std::shared_ptr<Allocator>& allocator, uint8_t* target, MidHookFn destination_fn, Flags flags) {
     m_target = target;
     m_destination = destination_fn;
 
@@ -964,7 +1161,8 @@ std::expected<void, MidHook::Error> MidHook::setup(
     store(m_stub.data() + 0x59, m_stub.data() + m_stub.size() - 8);
 #endif
 
-    auto hook_result = InlineHook::create(allocator, m_target, m_stub.data());
+    // Start disabled so the stub is complete before anything can jump to it.
+    auto hook_result = InlineHook::create(allocator, m_target, m_stub.data(), InlineHook::StartDisabled);
 
     if (!hook_result) {
         m_stub.free();
@@ -979,6 +1177,30 @@ std::expected<void, MidHook::Error> MidHook::setup(
     store(m_stub.data() + sizeof(asm_data) - 4, m_hook.trampoline().data());
 #endif
 
+    if (!(flags & StartDisabled)) {
+        if (auto enable_result = enable(); !enable_result) {
+            m_hook.reset();
+            m_stub.free();
+            return enable_result;
+        }
+    }
+
+    return {};
+}
+
+std::expected<void, MidHook::Error> MidHook::enable() {
+    if (auto enable_result = m_hook.enable(); !enable_result) {
+        return std::unexpected{Error::bad_inline_hook(enable_result.error())};
+    }
+
+    return {};
+}
+
+std::expected<void, MidHook::Error> MidHook::disable() {
+    if (auto disable_result = m_hook.disable(); !disable_result) {
+        return std::unexpected{Error::bad_inline_hook(disable_result.error())};
+    }
+
     return {};
 }
 } // namespace safetyhook
@@ -1345,8 +1567,60 @@ SystemInfo system_info() {
     return info;
 }
 
+// Set while this thread has every other thread frozen.
+static thread_local bool t_threads_frozen = false;
+
 void execute_while_frozen(
     const std::function<void()>& run_fn, const std::function<void(ThreadId, ThreadHandle, ThreadContext)>& visit_fn) {
+    // Nested call, e.g. enabling several hooks inside one freeze. Every other thread is already suspended so just
+    // visit their contexts and run. Nothing here may allocate, a suspended thread could be holding the heap lock.
+    if (t_threads_frozen) {
+        if (visit_fn) {
+            HANDLE thread{};
+
+            while (true) {
+                HANDLE next_thread{};
+                const auto status = NtGetNextThread(GetCurrentProcess(), thread,
+                    THREAD_QUERY_LIMITED_INFORMATION | THREAD_GET_CONTEXT | THREAD_SET_CONTEXT, 0, 0, &next_thread);
+
+                if (thread != nullptr) {
+                    CloseHandle(thread);
+                }
+
+                if (!NT_SUCCESS(status)) {
+                    break;
+                }
+
+                thread = next_thread;
+
+                const auto thread_id = GetThreadId(thread);
+
+                if (thread_id == 0 || thread_id == GetCurrentThreadId()) {
+                    continue;
+                }
+
+                CONTEXT thread_ctx{};
+
+                thread_ctx.ContextFlags = CONTEXT_FULL;
+
+                if (GetThreadContext(thread, &thread_ctx) == FALSE) {
+                    continue;
+                }
+
+                visit_fn(static_cast<ThreadId>(thread_id), static_cast<ThreadHandle>(thread),
+                    static_cast<ThreadContext>(&thread_ctx));
+
+                SetThreadContext(thread, &thread_ctx);
+            }
+        }
+
+        if (run_fn) {
+            run_fn();
+        }
+
+        return;
+    }
+
     // Freeze all threads.
     int num_threads_frozen;
     auto first_run = true;
@@ -1413,7 +1687,9 @@ void execute_while_frozen(
 
     // Run the function.
     if (run_fn) {
+        t_threads_frozen = true;
         run_fn();
+        t_threads_frozen = false;
     }
 
     // Resume all threads.
@@ -150,6 +150,24 @@ public:
     [[nodiscard]] std::expected<Allocation, Error> allocate_near(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
 
+    /// @brief Reserves one block of memory near target addresses up front. Later allocations within range are carved
+    /// from it before any other memory is searched for, so they end up packed together.
+    /// @param desired_addresses The target addresses.
+    /// @param size The size of the block, rounded up to the allocation granularity.
+    /// @param max_distance The maximum distance from the target addresses.
+    /// @return The address of the block or an Allocator::Error if the reservation failed.
+    [[nodiscard]] std::expected<uint8_t*, Error> reserve(
+        const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
+
+    /// @brief Makes all memory of this Allocator read and execute only.
+    /// @return True if every block was protected.
+    /// @note The next allocation makes the memory writable again. Only seal while no hooks are being created.
+    bool seal();
+
+    /// @brief Makes all memory of this Allocator writable again.
+    /// @return True if every block was unprotected.
+    bool unseal();
+
 protected:
     friend Allocation;
 
@@ -172,12 +190,14 @@ private:
 
     std::vector<std::unique_ptr<Memory>> m_memory{};
     std::mutex m_mutex{};
+    bool m_sealed{};
 
     Allocator() = default;
 
     [[nodiscard]] std::expected<Allocation, Error> internal_allocate_near(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
     void internal_free(uint8_t* address, size_t size);
+    bool internal_protect(bool writable);
 
     static void combine_adjacent_freenodes(Memory& memory);
     [[nodiscard]] static std::expected<uint8_t*, Error> allocate_nearby_memory(
@@ -336,7 +356,17 @@ template <typename T> constexpr T align_down(T address, size_t align) {
 }
 } // namespace safetyhook
 
+struct ZydisDecodedInstruction_;
+struct ZydisDecodedOperand_;
+
 namespace safetyhook {
+/// @brief Decodes one instruction and its operands with the calling thread's decoder, the one hooks are created with.
+/// @param ix The decoded instruction.
+/// @param operands Room for ZYDIS_MAX_OPERAND_COUNT operands.
+/// @param ip The address of the instruction.
+/// @return true if the instruction decoded.
+bool decode_full(ZydisDecodedInstruction_* ix, ZydisDecodedOperand_* operands, uint8_t* ip);
+
 /// @brief An inline hook.
 class InlineHook final {
 public:
@@ -405,6 +435,12 @@ public:
         [[nodiscard]] static Error not_enough_space(uint8_t* ip) { return {.type = NOT_ENOUGH_SPACE, .ip = ip}; }
     };
 
+    /// @brief Flags for InlineHook.
+    enum Flags : int {
+        Default = 0,            ///< Default flags.
+        StartDisabled = 1 << 0, ///< Start the hook disabled, it must be enabled with enable().
+    };
+
     /// @brief Create an inline hook.
     /// @param target The address of the function to hook.
     /// @param destination The destination address.
@@ -427,10 +463,11 @@ public:
     /// @param allocator The allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination The destination address.
+    /// @param flags The flags to use.
     /// @return The InlineHook or an InlineHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_inline).
     [[nodiscard]] static std::expected<InlineHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, void* target, void* destination);
+        const std::shared_ptr<Allocator>& allocator, void* target, void* destination, Flags flags = Default);
 
     /// @brief Create an inline hook with a given Allocator.
     /// @param allocator The allocator to use.
@@ -455,6 +492,19 @@ public:
     /// @note This is called automatically in the destructor.
     void reset();
 
+    /// @brief Enable the hook by writing the jump to the target.
+    /// @return Nothing or an InlineHook::Error if an error occurred.
+    /// @note Hooks are enabled on creation unless created with Flags::StartDisabled.
+    [[nodiscard]] std::expected<void, Error> enable();
+
+    /// @brief Disable the hook by restoring the original bytes. The trampoline is kept.
+    /// @return Nothing or an InlineHook::Error if an error occurred.
+    [[nodiscard]] std::expected<void, Error> disable();
+
+    /// @brief Check if the hook is enabled.
+    /// @return true if the hook is enabled, false otherwise.
+    [[nodiscard]] bool enabled() const { return m_enabled; }
+
     /// @brief Get a pointer to the target.
     /// @return A pointer to the target.
     [[nodiscard]] uint8_t* target() const { return m_target; }
@@ -612,9 +662,16 @@ private:
     std::vector<uint8_t> m_original_bytes{};
     uintptr_t m_trampoline_size{};
     std::recursive_mutex m_mutex{};
+    bool m_enabled{};
+
+    enum class Type {
+        Unset,
+        E9,
+        FF,
+    } m_type{Type::Unset};
 
     std::expected<void, Error> setup(
-        const std::shared_ptr<Allocator>& allocator, uint8_t* target, uint8_t* destination);
+        const std::shared_ptr<Allocator>& allocator, uint8_t* target, uint8_t* destination, Flags flags);
     std::expected<void, Error> e9_hook(const std::shared_ptr<Allocator>& allocator);
 
 #if SAFETYHOOK_ARCH_X86_64
@@ -749,6 +806,12 @@ public:
         }
     };
 
+    /// @brief Flags for MidHook.
+    enum Flags : int {
+        Default = 0,            ///< Default flags.
+        StartDisabled = 1 << 0, ///< Start the hook disabled, it must be enabled with enable().
+    };
+
     /// @brief Creates a new MidHook object.
     /// @param target The address of the function to hook.
     /// @param destination_fn The destination function.
@@ -771,10 +834,11 @@ public:
     /// @param allocator The Allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination_fn The destination function.
+    /// @param flags The flags to use.
     /// @return The MidHook object or a MidHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_mid).
     [[nodiscard]] static std::expected<MidHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination_fn);
+        const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination_fn, Flags flags = Default);
 
     /// @brief Creates a new MidHook object with a given Allocator.
     /// @tparam T The type of the function to hook.
@@ -800,6 +864,18 @@ public:
     /// @note This is called automatically in the destructor.
     void reset();
 
+    /// @brief Enable the hook.
+    /// @return Nothing or a MidHook::Error if an error occurred.
+    [[nodiscard]] std::expected<void, Error> enable();
+
+    /// @brief Disable the hook.
+    /// @return Nothing or a MidHook::Error if an error occurred.
+    [[nodiscard]] std::expected<void, Error> disable();
+
+    /// @brief Check if the hook is enabled.
+    /// @return true if the hook is enabled, false otherwise.
+    [[nodiscard]] bool enabled() const { return m_hook.enabled(); }
+
     /// @brief Get a pointer to the target.
     /// @return A pointer to the target.
     [[nodiscard]] uint8_t* target() const { return m_target; }
@@ -827,7 +903,7 @@ private:
     MidHookFn m_destination{};
 
     std::expected<void, Error> setup(
-        const std::shared_ptr<Allocator>& allocator, uint8_t* target, MidHookFn destination);
+        const std::shared_ptr<Allocator>& allocator, uint8_t* target, MidHookFn destination, Flags flags);
 };
 } // namespace safetyhook
 
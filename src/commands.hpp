@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+// Console commands waiting to run on the game thread.
+//
+// Any thread can push without blocking; the game thread takes the whole list with a single exchange whenever one of
+// its hooks runs and executes it in the order it was pushed. Taking the whole list at once means there is no ABA
+// problem and no limit on how many threads drain.
+namespace Console
+{
+    class CommandQueue
+    {
+    public:
+        CommandQueue() = default;
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        ~CommandQueue()
+        {
+            Free(m_head.exchange(nullptr, std::memory_order_acquire));
+        }
+
+        void Push(std::wstring command)
+        {
+            auto node = new Node{ std::move(command), m_head.load(std::memory_order_relaxed) };
+            while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+
+        // Cheap enough to call every frame.
+        bool Empty() const
+        {
+            return m_head.load(std::memory_order_relaxed) == nullptr;
+        }
+
+        // Calls execute(const std::wstring&) for every queued command, oldest first. Returns how many ran.
+        template<typename Execute>
+        std::size_t Drain(Execute&& execute)
+        {
+            if (Empty())
+                return 0;
+
+            // The list is newest first, reverse it
+            Node* oldest = nullptr;
+            for (Node* node = m_head.exchange(nullptr, std::memory_order_acquire); node;) {
+                Node* next = node->next;
+                node->next = oldest;
+                oldest = node;
+                node = next;
+            }
+
+            std::size_t count = 0;
+            while (oldest) {
+                Node* next = oldest->next;
+                execute(std::as_const(oldest->command));
+                delete oldest;
+                oldest = next;
+                ++count;
+            }
+            return count;
+        }
+
+    private:
+        struct Node
+        {
+            std::wstring command;
+            Node* next;
+        };
+
+        static void Free(Node* node)
+        {
+            while (node) {
+                Node* next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+
+        std::atomic<Node*> m_head{ nullptr };
+    };
+}
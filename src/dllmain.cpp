@@ -1,7 +1,22 @@
 #include "stdafx.h"
 #include "helper.hpp"
+#include "signatures.hpp"
+#include "transaction.hpp"
+#include "trace.hpp"
+#include "renderparams.hpp"
+#include "hookstats.hpp"
+#include "framelimiter.hpp"
+#include "frametimes.hpp"
+#include "lodgovernor.hpp"
+#include "commands.hpp"
+#include "tasks.hpp"
+#include "operand.hpp"
+#include "slimhook.hpp"
+#include "telemetry.hpp"
+#include "rescan.hpp"
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <inipp/inipp.h>
 #include <safetyhook.hpp>
@@ -21,12 +36,23 @@ std::string sConfigFile = sFixName + ".ini";
 
 // Logger
 std::shared_ptr<spdlog::logger> logger;
+const std::size_t iLogQueueSize = 8192;
+std::string sLogLevel = "info";
+std::string sLogOverflow = "block";
+int iLogFlushInterval = 1;
 std::filesystem::path sExePath;
 std::string sExeName;
 
+// Signatures
+Scanner::MultiScanner Scans;
+std::string sScanCacheFile = sFixName + ".cache";
+
+// When the first and the last feature's patches went live, ns since the fix was loaded
+std::atomic<std::int64_t> iFirstPatchTime = 0;
+std::atomic<std::int64_t> iLastPatchTime = 0;
+
 // Aspect ratio / FOV related
 std::pair DesktopDimensions = { 0,0 };
-const float fPi = 3.1415926535f;
 const float fNativeAspect = 1.777777791f;
 float fAspectRatio;
 float fAspectMultiplier;
@@ -34,15 +60,33 @@ float fHUDWidth;
 float fHUDWidthOffset;
 float fHUDHeight;
 float fHUDHeightOffset;
+Render::Snapshot RenderParams;
 
 // Ini variables
 bool bUncapFPS;
+float fFramerateLimit = 0.00f;
 bool bFixResolution;
 bool bFixAspect;
 bool bFixFOV;
 float fAdditionalFOV;
 bool bFixHUD;
 bool bLODDistance;
+float fLODDistanceFactor = 0.001f;
+bool bLODRedirectStore;
+bool bLODAdaptive;
+float fLODTargetFPS = 60.00f;
+float fLODMinFactor = 0.001f;
+float fLODMaxFactor = 1.00f;
+bool bStartupTrace;
+bool bHookStats;
+int iHookStatsInterval = 10;
+bool bFrameTimes;
+int iFrameTimesInterval = 30;
+bool bConsoleCommands;
+bool bTrampolineArena = true;
+bool bTelemetry;
+bool bRescan = true;
+int iRescanDeadline = 120;
 
 // Variables
 int iCurrentResX;
@@ -50,9 +94,21 @@ int iCurrentResY;
 int iOldResX;
 int iOldResY;
 bool bIsMoviePlaying = false;
+FrameLimiter::Limiter<FrameLimiter::SteadyClock, FrameLimiter::PlatformSleeper> FrameLimit;
+FrameTimes::Capture FrameTimeCapture;
+LOD::Governor LODGovernor;
+std::atomic<float> fCurrentLODFactor = 0.001f;
+std::atomic<float*> pLODDistanceFactor = nullptr;   // The game's own variable, once its store has been redirected
+Console::CommandQueue ConsoleCommands;
+Telemetry::Writer TelemetryWriter;
+std::vector<std::pair<std::string, std::function<bool()>>> LateFeatures;    // Failed at startup, retried by the rescanner
+std::atomic<bool> bDetaching = false;  // Set on DLL_PROCESS_DETACH, background threads stop at their next wake-up
+std::shared_ptr<safetyhook::Allocator> HookAllocator;  // Keeps the arena alive, the global allocator only lives while referenced
 
 void Logging()
 {
+    Trace::Scope trace("Logging");
+
     // Get this module path
     WCHAR thisModulePath[_MAX_PATH] = { 0 };
     GetModuleFileNameW(thisModule, thisModulePath, MAX_PATH);
@@ -66,13 +122,40 @@ void Logging()
     sExeName = sExePath.filename().string();
     sExePath = sExePath.remove_filename();
 
+    // The logger has to exist before the rest of the config is parsed, so read its settings first
+    {
+        inipp::Ini<char> logIni;
+        std::ifstream iniFile(sThisModulePath.string() + sConfigFile);
+        if (iniFile) {
+            logIni.parse(iniFile);
+            logIni.strip_trailing_comments();
+            inipp::get_value(logIni.sections["Logging"], "Level", sLogLevel);
+            inipp::get_value(logIni.sections["Logging"], "Overflow", sLogOverflow);
+            inipp::get_value(logIni.sections["Logging"], "FlushInterval", iLogFlushInterval);
+        }
+    }
+
     // spdlog initialisation
     {
         try {
-            logger = spdlog::basic_logger_st(sFixName.c_str(), sExePath.string() + sLogFile, true);
+            // Lines are queued and written by a background thread, so neither startup nor hooks wait on the disk.
+            // This is spdlog's queue: formatting still happens on the logging thread and the queue takes a lock.
+            // Overrun_oldest is the only policy that never waits, at the price of already queued lines.
+            spdlog::init_thread_pool(iLogQueueSize, 1, []() { SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL); });
+            auto overflowPolicy = sLogOverflow == "drop" ? spdlog::async_overflow_policy::overrun_oldest : spdlog::async_overflow_policy::block;
+            auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(sExePath.string() + sLogFile, true);
+            logger = std::make_shared<spdlog::async_logger>(sFixName, fileSink, spdlog::thread_pool(), overflowPolicy);
             spdlog::set_default_logger(logger);
 
-            spdlog::flush_on(spdlog::level::debug);
+            auto logLevel = spdlog::level::from_str(sLogLevel);
+            if (logLevel == spdlog::level::off && sLogLevel != "off")
+                logLevel = spdlog::level::info;
+            spdlog::set_level(logLevel);
+
+            // Batch flushes, but get warnings and errors on disk straight away
+            iLogFlushInterval = std::clamp(iLogFlushInterval, 1, 60);
+            spdlog::flush_every(std::chrono::seconds(iLogFlushInterval));
+            spdlog::flush_on(spdlog::level::warn);
             spdlog::info("----------");
             spdlog::info("{} v{} loaded.", sFixName.c_str(), sFixVer.c_str());
             spdlog::info("----------");
@@ -97,6 +180,8 @@ void Logging()
 
 void Configuration()
 {
+    Trace::Scope trace("Configuration");
+
     // inipp initialisation
     std::ifstream iniFile(sThisModulePath.string() + sConfigFile);
     if (!iniFile) {
@@ -121,6 +206,14 @@ void Configuration()
     inipp::get_value(ini.sections["Uncap Framerate"], "Enabled", bUncapFPS);
     spdlog::info("Config Parse: bUncapFPS: {}", bUncapFPS);
 
+    inipp::get_value(ini.sections["Uncap Framerate"], "FramerateLimit", fFramerateLimit);
+    if (fFramerateLimit != 0.00f && (fFramerateLimit < 30.00f || fFramerateLimit > 1000.00f)) {
+        fFramerateLimit = std::clamp(fFramerateLimit, 30.00f, 1000.00f);
+        spdlog::warn("Config Parse: fFramerateLimit value invalid, clamped to {}", fFramerateLimit);
+    }
+    spdlog::info("Config Parse: fFramerateLimit: {}", fFramerateLimit);
+    FrameLimit.SetTarget(fFramerateLimit);
+
     inipp::get_value(ini.sections["Gameplay FOV"], "AdditionalFOV", fAdditionalFOV);
     if (fAdditionalFOV < -80.00f || fAdditionalFOV > 80.00f) {
         fAdditionalFOV = std::clamp(fAdditionalFOV, -80.00f, 80.00f);
@@ -143,9 +236,224 @@ void Configuration()
     inipp::get_value(ini.sections["LOD Distance"], "Enabled", bLODDistance);
     spdlog::info("Config Parse: bLODDistance: {}", bLODDistance);
 
+    inipp::get_value(ini.sections["LOD Distance"], "Factor", fLODDistanceFactor);
+    if (fLODDistanceFactor < 0.0001f || fLODDistanceFactor > 10.00f) {
+        fLODDistanceFactor = std::clamp(fLODDistanceFactor, 0.0001f, 10.00f);
+        spdlog::warn("Config Parse: fLODDistanceFactor value invalid, clamped to {}", fLODDistanceFactor);
+    }
+    spdlog::info("Config Parse: fLODDistanceFactor: {}", fLODDistanceFactor);
+
+    inipp::get_value(ini.sections["LOD Distance"], "Adaptive", bLODAdaptive);
+    bLODAdaptive = bLODAdaptive && bLODDistance;
+    spdlog::info("Config Parse: bLODAdaptive: {}", bLODAdaptive);
+
+    inipp::get_value(ini.sections["LOD Distance"], "TargetFPS", fLODTargetFPS);
+    if (fLODTargetFPS < 20.00f || fLODTargetFPS > 1000.00f) {
+        fLODTargetFPS = std::clamp(fLODTargetFPS, 20.00f, 1000.00f);
+        spdlog::warn("Config Parse: fLODTargetFPS value invalid, clamped to {}", fLODTargetFPS);
+    }
+    spdlog::info("Config Parse: fLODTargetFPS: {}", fLODTargetFPS);
+
+    inipp::get_value(ini.sections["LOD Distance"], "MinFactor", fLODMinFactor);
+    inipp::get_value(ini.sections["LOD Distance"], "MaxFactor", fLODMaxFactor);
+    fLODMinFactor = std::clamp(fLODMinFactor, 0.0001f, 10.00f);
+    if (fLODMaxFactor < fLODMinFactor || fLODMaxFactor > 10.00f) {
+        fLODMaxFactor = std::clamp(fLODMaxFactor, fLODMinFactor, 10.00f);
+        spdlog::warn("Config Parse: fLODMaxFactor value invalid, clamped to {}", fLODMaxFactor);
+    }
+    spdlog::info("Config Parse: fLODMinFactor: {}", fLODMinFactor);
+    spdlog::info("Config Parse: fLODMaxFactor: {}", fLODMaxFactor);
+
+    inipp::get_value(ini.sections["LOD Distance"], "RedirectStore", bLODRedirectStore);
+    spdlog::info("Config Parse: bLODRedirectStore: {}", bLODRedirectStore);
+
+    fCurrentLODFactor = fLODDistanceFactor;
+    if (bLODAdaptive) {
+        LOD::GovernorConfig governorConfig;
+        governorConfig.fTargetFrameTime = 1000.00f / fLODTargetFPS;
+        governorConfig.fMinFactor = fLODMinFactor;
+        governorConfig.fMaxFactor = fLODMaxFactor;
+        LODGovernor = LOD::Governor(governorConfig);
+        fCurrentLODFactor = LODGovernor.Factor();
+    }
+
+    inipp::get_value(ini.sections["Startup Trace"], "Enabled", bStartupTrace);
+    spdlog::info("Config Parse: bStartupTrace: {}", bStartupTrace);
+    Trace::Enable(bStartupTrace);
+
+    inipp::get_value(ini.sections["Hook Stats"], "Enabled", bHookStats);
+    spdlog::info("Config Parse: bHookStats: {}", bHookStats);
+    HookStats::Enabled = bHookStats;
+
+    inipp::get_value(ini.sections["Hook Stats"], "Interval", iHookStatsInterval);
+    if (iHookStatsInterval < 1 || iHookStatsInterval > 3600) {
+        iHookStatsInterval = std::clamp(iHookStatsInterval, 1, 3600);
+        spdlog::warn("Config Parse: iHookStatsInterval value invalid, clamped to {}", iHookStatsInterval);
+    }
+    spdlog::info("Config Parse: iHookStatsInterval: {}", iHookStatsInterval);
+
+    inipp::get_value(ini.sections["Frame Times"], "Enabled", bFrameTimes);
+    spdlog::info("Config Parse: bFrameTimes: {}", bFrameTimes);
+
+    inipp::get_value(ini.sections["Frame Times"], "Interval", iFrameTimesInterval);
+    if (iFrameTimesInterval < 1 || iFrameTimesInterval > 3600) {
+        iFrameTimesInterval = std::clamp(iFrameTimesInterval, 1, 3600);
+        spdlog::warn("Config Parse: iFrameTimesInterval value invalid, clamped to {}", iFrameTimesInterval);
+    }
+    spdlog::info("Config Parse: iFrameTimesInterval: {}", iFrameTimesInterval);
+
+    inipp::get_value(ini.sections["Trampoline Arena"], "Enabled", bTrampolineArena);
+    spdlog::info("Config Parse: bTrampolineArena: {}", bTrampolineArena);
+
+    inipp::get_value(ini.sections["Rescan"], "Enabled", bRescan);
+    spdlog::info("Config Parse: bRescan: {}", bRescan);
+
+    inipp::get_value(ini.sections["Rescan"], "Deadline", iRescanDeadline);
+    if (iRescanDeadline < 1 || iRescanDeadline > 3600) {
+        iRescanDeadline = std::clamp(iRescanDeadline, 1, 3600);
+        spdlog::warn("Config Parse: iRescanDeadline value invalid, clamped to {}", iRescanDeadline);
+    }
+    spdlog::info("Config Parse: iRescanDeadline: {}", iRescanDeadline);
+
+    inipp::get_value(ini.sections["Telemetry"], "Enabled", bTelemetry);
+    spdlog::info("Config Parse: bTelemetry: {}", bTelemetry);
+
+    // Numbered from 1, run in order once the game is up
+    for (int i = 1; ini.sections["Console Commands"].contains("Command" + std::to_string(i)); ++i) {
+        const std::string& sCommand = ini.sections["Console Commands"]["Command" + std::to_string(i)];
+        if (sCommand.empty())
+            continue;
+        ConsoleCommands.Push(Util::string_to_wstring(sCommand));
+        bConsoleCommands = true;
+        spdlog::info("Config Parse: Console command {}: {}", i, sCommand);
+    }
+
+    if (spdlog::level::from_str(sLogLevel) == spdlog::level::off && sLogLevel != "off")
+        spdlog::warn("Config Parse: sLogLevel value invalid, using info");
+    spdlog::info("Config Parse: sLogLevel: {}", sLogLevel);
+    if (sLogOverflow != "block" && sLogOverflow != "drop")
+        spdlog::warn("Config Parse: sLogOverflow value invalid, using block");
+    spdlog::info("Config Parse: sLogOverflow: {}", sLogOverflow);
+    spdlog::info("Config Parse: iLogFlushInterval: {}", iLogFlushInterval);
+
+    spdlog::info("----------");
+}
+
+void LoadScanCache()
+{
+    std::ifstream cacheFile(sThisModulePath.string() + sScanCacheFile);
+    if (!cacheFile)
+        return;
+
+    inipp::Ini<char> cache;
+    cache.parse(cacheFile);
+
+    // The cache is only valid for the exact executable it was written for
+    std::uint32_t iTimestamp = 0;
+    std::uint32_t iSizeOfImage = 0;
+    inipp::get_value(cache.sections["Scan Cache"], "Timestamp", iTimestamp);
+    inipp::get_value(cache.sections["Scan Cache"], "SizeOfImage", iSizeOfImage);
+    if (iTimestamp != Memory::ModuleTimestamp(baseModule) || iSizeOfImage != Scanner::ImageSize((std::uint8_t*)baseModule)) {
+        spdlog::info("Scan Cache: Game executable has changed, ignoring cache.");
+        return;
+    }
+
+    const auto& entries = Scans.Entries();
+    for (std::size_t id = 0; id < entries.size(); ++id) {
+        std::string sOffset;
+        if (!inipp::get_value(cache.sections["Signatures"], entries[id].name, sOffset))
+            continue;
+
+        // Re-match the signature at the cached offset before trusting it
+        std::size_t iOffset = std::strtoull(sOffset.c_str(), nullptr, 16);
+        if (iOffset && Memory::SignatureAt(baseModule, iOffset, entries[id].pattern, entries[id].scope))
+            Scans.Resolve(id, (std::uint8_t*)baseModule + iOffset);
+        else
+            spdlog::warn("Scan Cache: {} no longer matches at {:s}+{:x}, rescanning.", entries[id].name, sExeName.c_str(), iOffset);
+    }
+}
+
+void SaveScanCache()
+{
+    std::ofstream cacheFile(sThisModulePath.string() + sScanCacheFile, std::ios::trunc);
+    if (!cacheFile) {
+        spdlog::warn("Scan Cache: Could not write {}", sThisModulePath.string() + sScanCacheFile);
+        return;
+    }
+
+    cacheFile << "[Scan Cache]\n";
+    cacheFile << "Timestamp = " << Memory::ModuleTimestamp(baseModule) << "\n";
+    cacheFile << "SizeOfImage = " << Scanner::ImageSize((std::uint8_t*)baseModule) << "\n";
+    cacheFile << "\n[Signatures]\n";
+    for (const auto& entry : Scans.Entries()) {
+        if (entry.result.address)
+            cacheFile << entry.name << " = " << std::hex << (entry.result.address - (std::uint8_t*)baseModule) << std::dec << "\n";
+    }
+}
+
+void Signatures()
+{
+    Trace::Scope trace("Signatures");
+
+    // Register the signatures of every enabled feature so the image only has to be read once
+    if (bFixResolution)
+        Scans.Add("Resolution", Signature::Resolution);
+    if (bFixAspect)
+        Scans.Add("Cutscene Aspect Ratio", Signature::CutsceneAspectRatio);
+    if (bFixFOV || fAdditionalFOV != 0.00f)
+        Scans.Add("FOV", Signature::FOV);
+    if (bFixHUD)
+        Scans.Add("HUD", Signature::HUD);
+    if (bUncapFPS)
+        Scans.Add("IsMoviePlaying", Signature::IsMoviePlaying);
+    if (bUncapFPS || bFrameTimes || bLODAdaptive || bTelemetry)
+        Scans.Add("Framerate Cap", Signature::FramerateCap);
+    if (bLODDistance)
+        Scans.Add("LOD Distance", Signature::LODDistance);
+    if (bConsoleCommands)
+        Scans.Add("UGameEngine::Exec", Signature::EngineExec);
+
+    // Reuse offsets from the last launch if the game executable hasn't changed
+    LoadScanCache();
+
+    std::size_t iPending = Scans.Pending();
+    if (iPending) {
+        Memory::SignatureScan(baseModule, Scans);
+
+        for (const auto& entry : Scans.Entries()) {
+            if (entry.result.count > 1)
+                spdlog::warn("Signatures: {} matched {} times, using the first match.", entry.name, entry.result.count);
+        }
+        SaveScanCache();
+    }
+    spdlog::info("Signatures: {} cached, {} scanned in a single pass.", Scans.Entries().size() - iPending, iPending);
     spdlog::info("----------");
 }
 
+bool Apply(Memory::Transaction& patches, const char* sFeature)
+{
+    if (!patches.Patches() && !patches.Hooks())
+        return patches.Commit();
+
+    // Write the feature's patches and enable its hooks under a single thread freeze. Each feature commits on its own
+    // as soon as it has staged everything, so it goes live without waiting for the others and fails on its own.
+    if (!patches.Commit()) {
+        spdlog::error("{}: {} Nothing was applied.", sFeature, patches.Error());
+        return false;
+    }
+    spdlog::info("{}: Applied {} patches and {} hooks.", sFeature, patches.Patches(), patches.Hooks());
+    if (!patches.Error().empty())
+        spdlog::warn("{}: Left out part of it: {}", sFeature, patches.Error());
+    TelemetryWriter.AddApplied(patches.Patches(), patches.Hooks());
+
+    std::int64_t iNow = Trace::Now();
+    std::int64_t iFirst = 0;
+    iFirstPatchTime.compare_exchange_strong(iFirst, iNow);
+    for (std::int64_t iLast = iLastPatchTime; iLast < iNow && !iLastPatchTime.compare_exchange_weak(iLast, iNow);)
+        ;
+    return true;
+}
+
 void CalculateAspectRatio(bool bLog)
 {
     // Calculate aspect ratio
@@ -165,6 +473,21 @@ void CalculateAspectRatio(bool bLog)
         fHUDHeightOffset = (float)(iCurrentResY - fHUDHeight) / 2.00f;
     }
 
+    // Publish everything the per-frame hooks need in one go
+    Render::Params params;
+    params.fAspectRatio = fAspectRatio;
+    params.fAspectMultiplier = fAspectMultiplier;
+    params.fFOVScale = fAspectRatio > fNativeAspect ? fAspectMultiplier : 1.00f;
+    params.bPillarbox = fAspectRatio > fNativeAspect;
+    params.bLetterbox = fAspectRatio < fNativeAspect;
+    params.iHUDWidth = (int)ceilf(fHUDWidth);
+    params.iHUDHeight = (int)ceilf(fHUDHeight);
+    params.iHUDWidthOffset = (int)ceilf(fHUDWidthOffset);
+    params.iHUDHeightOffset = (int)ceilf(fHUDHeightOffset);
+    RenderParams.Publish(params);
+    TelemetryWriter.SetScreen({ iCurrentResX, iCurrentResY, params.fAspectRatio, params.fAspectMultiplier, params.fFOVScale,
+        params.iHUDWidth, params.iHUDHeight, params.iHUDWidthOffset, params.iHUDHeightOffset });
+
     if (bLog) {
         // Log details about current resolution
         spdlog::info("----------");
@@ -179,114 +502,282 @@ void CalculateAspectRatio(bool bLog)
     }
 }
 
-void Resolution()
+void CurrentResolution_hk(SafetyHookContext& ctx)
 {
+    // Log current resolution
+    int iResX = (int)ctx.rdx;
+    int iResY = (int)ctx.r8;
+
+    if (iResX != iCurrentResX || iResY != iCurrentResY) {
+        iCurrentResX = iResX;
+        iCurrentResY = iResY;
+        CalculateAspectRatio(true);
+    }
+}
+
+void Display()
+{
+    Trace::Scope trace("Display");
+
     // Grab desktop resolution/aspect just in case
     DesktopDimensions = Util::GetPhysicalDesktopDimensions();
     iCurrentResX = DesktopDimensions.first;
     iCurrentResY = DesktopDimensions.second;
     CalculateAspectRatio(false);
+}
+
+bool Resolution()
+{
+    Trace::Scope trace("Resolution");
+    Memory::Transaction Patches;
+    bool bResult = true;
 
     if (bFixResolution) {
         // Stop resolution from being scaled to 16:9 and log current resolution
-        std::uint8_t* ResolutionFixScanResult = Memory::PatternScan(baseModule, "76 ?? C5 ?? ?? ?? C4 ?? ?? ?? ?? 8B ?? 41 ?? ?? ?? ?? ?? ??");
+        std::uint8_t* ResolutionFixScanResult = Scans.Get("Resolution");
         if (ResolutionFixScanResult) {
             spdlog::info("Resolution: Address is {:s}+{:x}", sExeName.c_str(), ResolutionFixScanResult - (std::uint8_t*)baseModule);
             // Jump past code that resizes the resolution 16:9
-            Memory::PatchBytes(ResolutionFixScanResult, "\xEB\x09", 2);
+            Patches.PatchBytes(ResolutionFixScanResult, "\xEB\x09", 2);
             spdlog::info("Resolution: Patched instruction.");
 
+            // Only logs and tracks the resolution, the patch above doesn't need it. Its stolen bytes depend on how the
+            // code decodes and could reach the patch, which then leaves out just this hook.
             static SafetyHookMid CurrentResolutionMidHook{};
-            CurrentResolutionMidHook = safetyhook::create_mid(ResolutionFixScanResult - 0xD,
-                [](SafetyHookContext& ctx) {
-                    // Log current resolution
-                    int iResX = (int)ctx.rdx;
-                    int iResY = (int)ctx.r8;
-
-                    if (iResX != iCurrentResX || iResY != iCurrentResY) {
-                        iCurrentResX = iResX;
-                        iCurrentResY = iResY;
-                        CalculateAspectRatio(true);
-                    }
-                });
+            Patches.Batch();
+            Patches.MidHook(CurrentResolutionMidHook, ResolutionFixScanResult - 0xD, HookStats::Mid<CurrentResolution_hk>("Resolution"));
         }
         else {
             spdlog::error("Resolution: Pattern scan failed.");
+            bResult = false;
         }
     }
+
+    return Apply(Patches, "Resolution") && bResult;
 }
 
-void AspectRatio()
+bool AspectRatio()
 {
+    Trace::Scope trace("AspectRatio");
+    Memory::Transaction Patches;
+    bool bResult = true;
+
     if (bFixAspect) {
         // Cutscene aspect ratio
-        std::uint8_t* CutsceneAspectRatioScanResult = Memory::PatternScan(baseModule, "F6 ?? ?? ?? ?? ?? 02 0F 84 ?? ?? ?? ?? F3 44 ?? ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ??");
+        std::uint8_t* CutsceneAspectRatioScanResult = Scans.Get("Cutscene Aspect Ratio");
         if (CutsceneAspectRatioScanResult) {
             spdlog::info("Cutscene Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), CutsceneAspectRatioScanResult - (std::uint8_t*)baseModule);
             // Force the test instruction for "bConstrainAspectRatio" to always set ZF so it jumps as though it was disabled
-            Memory::PatchBytes(CutsceneAspectRatioScanResult + 0x6, "\x00", 1);
+            Patches.PatchBytes(CutsceneAspectRatioScanResult + 0x6, "\x00", 1);
             spdlog::info("Cutscene Aspect Ratio: Patched instruction.");
         }
         else {
             spdlog::error("Cutscene Aspect Ratio: Pattern scan failed.");
+            bResult = false;
         }
     }
+
+    return Apply(Patches, "AspectRatio") && bResult;
+}
+
+using FOVContext = SlimHook::Context<SlimHook::Xmm(9) | SlimHook::Rcx>;
+
+void FOV_hk(FOVContext& ctx)
+{
+    float& fFOV = ctx.Xmm<9>().f32[0];
+    if (bFixFOV) {
+        // Fix vert- FOV at >16:9
+        const auto params = RenderParams.Get();
+        if (params.bPillarbox)
+            fFOV = Render::CorrectFOV(params, fFOV);
+    }
+
+    uintptr_t rcx = ctx.Gpr<SlimHook::Rcx>();
+    if (fAdditionalFOV != 0.00f && rcx) {
+        // Only apply additional FOV outside of cutscenes by checking for bConstrainAspectRatio
+        if (!(*(reinterpret_cast<uint8_t*>(rcx + 0x270)) & 0x02))
+            fFOV += fAdditionalFOV;
+    }
 }
 
-void FOV()
+bool FOV()
 {
+    Trace::Scope trace("FOV");
+    Memory::Transaction Patches;
+    bool bResult = true;
+
     if (bFixFOV || fAdditionalFOV != 0.00f) {
         // FOV
-        std::uint8_t* FOVScanResult = Memory::PatternScan(baseModule, "41 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? 48 ?? ?? ?? 49 ?? ?? E8 ?? ?? ?? ??");
+        std::uint8_t* FOVScanResult = Scans.Get("FOV");
         if (FOVScanResult) {
             spdlog::info("FOV: Address is {:s}+{:x}", sExeName.c_str(), FOVScanResult - (std::uint8_t*)baseModule);
-            static SafetyHookMid FOVMidHook{};
-            FOVMidHook = safetyhook::create_mid(FOVScanResult,
-                [](SafetyHookContext& ctx) {
-                    if (bFixFOV) {
-                        // Fix vert- FOV at >16:9
-                        if (fAspectRatio > fNativeAspect)
-                            ctx.xmm9.f32[0] = atanf(tanf(ctx.xmm9.f32[0] * (fPi / 360)) / fNativeAspect * fAspectRatio) * (360 / fPi);
-                    }
-
-                    if (fAdditionalFOV != 0.00f && ctx.rcx) {
-                        // Only apply additional FOV outside of cutscenes by checking for bConstrainAspectRatio
-                        if (!(*(reinterpret_cast<uint8_t*>(ctx.rcx + 0x270)) & 0x02))
-                            ctx.xmm9.f32[0] += fAdditionalFOV;
-                    }
-                });
+            static SlimHook::Hook FOVMidHook{};
+            Patches.SlimHook(FOVMidHook, FOVScanResult, HookStats::Slim<FOV_hk>("FOV"));
         }
         else {
             spdlog::error("FOV: Pattern scan failed.");
+            bResult = false;
         }
     }
+
+    return Apply(Patches, "FOV") && bResult;
 }
 
-void HUD()
+using HUDContext = SlimHook::Context<SlimHook::Rbx | SlimHook::Rdi | SlimHook::R8 | SlimHook::R9>;
+
+void HUD_hk(HUDContext& ctx)
 {
+    // Set canvas size and offset
+    const auto params = RenderParams.Get();
+    if (params.bPillarbox) {
+        ctx.Gpr<SlimHook::Rbx>() = params.iHUDWidthOffset;
+        ctx.Gpr<SlimHook::R8>() = params.iHUDWidth;
+    }
+    else if (params.bLetterbox) {
+        ctx.Gpr<SlimHook::Rdi>() = params.iHUDHeightOffset;
+        ctx.Gpr<SlimHook::R9>() = params.iHUDHeight;
+    }
+}
+
+bool HUD()
+{
+    Trace::Scope trace("HUD");
+    Memory::Transaction Patches;
+    bool bResult = true;
+
     if (bFixHUD) {
         // HUD
-        std::uint8_t* HUDScanResult = Memory::PatternScan(baseModule, "45 ?? ?? ?? ?? ?? ?? 45 ?? ?? ?? ?? ?? ?? 49 ?? ?? ?? ?? ?? ?? 49 ?? ?? E8 ?? ?? ?? ??");
+        std::uint8_t* HUDScanResult = Scans.Get("HUD");
         if (HUDScanResult) {
             spdlog::info("HUD: Address is {:s}+{:x}", sExeName.c_str(), HUDScanResult - (std::uint8_t*)baseModule);
-            static SafetyHookMid HUDMidHook{};
-            HUDMidHook = safetyhook::create_mid(HUDScanResult,
-                [](SafetyHookContext& ctx) {
-                    // Set canvas size and offset
-                    if (fAspectRatio > fNativeAspect) {
-                        ctx.rbx = (int)ceilf(fHUDWidthOffset);
-                        ctx.r8 = (int)ceilf(fHUDWidth);
-                    }
-                    else if (fAspectRatio < fNativeAspect) {
-                        ctx.rdi = (int)ceilf(fHUDHeightOffset);
-                        ctx.r9 = (int)ceilf(fHUDHeight);
-                    }
-                });
+            static SlimHook::Hook HUDMidHook{};
+            Patches.SlimHook(HUDMidHook, HUDScanResult, HookStats::Slim<HUD_hk>("HUD"));
         }
         else {
             spdlog::error("HUD: Pattern scan failed.");
+            bResult = false;
+        }
+    }
+
+    return Apply(Patches, "HUD") && bResult;
+}
+
+typedef void(__thiscall* EngineExecType)(size_t, const wchar_t*, size_t);
+EngineExecType EngineExec_fn = nullptr;
+
+std::uint8_t* GEngine = nullptr;
+size_t FOutputDevice = 0;
+
+SafetyHookInline EngineExec_sh{};
+
+// Runs queued commands on the calling thread, which must be the game thread. Needs GEngine and FOutputDevice, which
+// only the engine's own first call to UGameEngine::Exec() provides. Only called from EngineExec_hk, once the original
+// has returned: a mid-hook can sit anywhere in a frame, with engine state half updated.
+void ExecuteConsoleCommands()
+{
+    if (!GEngine || !FOutputDevice)
+        return;
+
+    ConsoleCommands.Drain([](const std::wstring& command) {
+        spdlog::info("Console Commands: Executing \"{}\"", Util::wstring_to_string(command.c_str()));
+        EngineExec_sh.thiscall<void>((size_t)GEngine, command.c_str(), FOutputDevice);
+        });
+}
+
+void EngineExec_hk(size_t gameEngine, const wchar_t* cmd, size_t outputDevice)
+{
+    // GEngine
+    GEngine = (uint8_t*)gameEngine;
+    //spdlog::info("UGameEngine::Exec(): GEngine address: {:x}", (uintptr_t)GEngine);
+
+    // FOutputDevice
+    if (FOutputDevice == 0)
+        FOutputDevice = outputDevice;
+
+    // Log command
+    //spdlog::info("UGameEngine::Exec(): Executed command: {}", Util::wstring_to_string(cmd));
+
+    // Call original function
+    EngineExec_sh.thiscall<void>(gameEngine, cmd, outputDevice);
+
+    ExecuteConsoleCommands();
+}
+
+bool UE()
+{
+    Trace::Scope trace("UE");
+    Memory::Transaction Patches;
+    bool bResult = true;
+
+    if (bConsoleCommands) {
+        // UGameEngine::Exec()
+        std::uint8_t* EngineExecScanResult = Scans.Get("UGameEngine::Exec");
+        if (EngineExecScanResult) {
+            spdlog::info("UGameEngine::Exec(): Address is {:s}+{:x}", sExeName.c_str(), EngineExecScanResult - (std::uint8_t*)baseModule);
+            EngineExec_fn = (EngineExecType)EngineExecScanResult;
+            Patches.InlineHook(EngineExec_sh, EngineExecScanResult, HookStats::Inline<EngineExec_hk>("UGameEngine::Exec"));
+        }
+        else {
+            spdlog::error("UGameEngine::Exec(): Pattern scan failed.");
+            bResult = false;
+        }
+    }
+
+    return Apply(Patches, "UE") && bResult;
+}
+
+void LODGovernor_Update(float fFrameTime)
+{
+    auto previousState = LODGovernor.GetState();
+    float fFactor = LODGovernor.Update(fFrameTime);
+    fCurrentLODFactor.store(fFactor, std::memory_order_relaxed);
+    if (auto variable = pLODDistanceFactor.load(std::memory_order_relaxed))
+        std::atomic_ref<float>(*variable).store(fFactor, std::memory_order_relaxed);
+    TelemetryWriter.SetLOD(fFactor, static_cast<Telemetry::LODState>(LODGovernor.GetState()));
+
+    // Hysteresis keeps these rare
+    if (LODGovernor.GetState() != previousState) {
+        const char* sState = LODGovernor.GetState() == LOD::Governor::State::Raising ? "Raising detail" :
+                             LODGovernor.GetState() == LOD::Governor::State::Lowering ? "Lowering detail" : "Holding";
+        spdlog::info("LOD Distance: {}, factor {:.4f} at {:.2f} ms average frame time", sState, LODGovernor.Factor(), LODGovernor.AverageFrameTime());
+    }
+}
+
+void FramerateCap_hk(SafetyHookContext& ctx)
+{
+    // Time the game spent on the frame, not counting our own pacing below
+    static std::chrono::steady_clock::time_point frameStart{};
+    if (bLODAdaptive) {
+        auto now = std::chrono::steady_clock::now();
+        if (frameStart.time_since_epoch().count())
+            LODGovernor_Update(std::chrono::duration<float, std::milli>(now - frameStart).count());
+    }
+
+    if (bUncapFPS) {
+        if (bIsMoviePlaying) {
+            // Movies keep the native cap, pick the schedule back up from scratch afterwards
+            FrameLimit.Reset();
+        }
+        else {
+            // Uncap framerate, then pace frames ourselves if a limit is set
+            ctx.xmm0.f32[0] = 0.00f;
+            FrameLimit.Wait();
         }
     }
+
+    // Runs once per frame, after any pacing
+    if (bFrameTimes)
+        FrameTimeCapture.Record();
+    TelemetryWriter.Frame();
+
+    if (bLODAdaptive)
+        frameStart = std::chrono::steady_clock::now();
+}
+
+void LODDistanceFactor_hk(SafetyHookContext& ctx)
+{
+    // Set "LODDistanceFactor"
+    ctx.xmm1.f32[0] = fCurrentLODFactor.load(std::memory_order_relaxed);
 }
 
 SafetyHookInline IsMoviePlaying_sh{};
@@ -295,129 +786,329 @@ bool IsMoviePlaying_hk()
     return (bIsMoviePlaying = IsMoviePlaying_sh.fastcall<bool>());
 }
 
-void Misc()
+bool Misc()
 {
-    if (bUncapFPS) {
+    Trace::Scope trace("Misc");
+    Memory::Transaction Patches;
+    bool bResult = true;
+    float* pLODVariable = nullptr;
+    static SafetyHookMid FramerateCapMidHook{};
+    static SafetyHookMid LODDistanceFactorMidHook{};
+
+    // Runs again when the rescanner finds a signature that was missing, parts that are already live are skipped
+    if (bUncapFPS && !IsMoviePlaying_sh) {
         // WS_GameInfo::IsMoviePlaying()
-        std::uint8_t* IsMoviePlayingScanResult = Memory::PatternScan(baseModule, "48 ?? ?? ?? 48 ?? ?? ?? ?? ?? ?? 48 ?? ?? FF ?? ?? 83 ?? ?? 01 7E ??");
+        std::uint8_t* IsMoviePlayingScanResult = Scans.Get("IsMoviePlaying");
         if (IsMoviePlayingScanResult) {
             spdlog::info("IsMoviePlaying: Address is {:s}+{:x}", sExeName.c_str(), IsMoviePlayingScanResult - (std::uint8_t*)baseModule);
-            IsMoviePlaying_sh = safetyhook::create_inline(IsMoviePlayingScanResult, reinterpret_cast<void*>(IsMoviePlaying_hk));
-            if (IsMoviePlaying_sh) 
-                spdlog::info("IsMoviePlaying: Hooked function successfully.");
+            Patches.InlineHook(IsMoviePlaying_sh, IsMoviePlayingScanResult, HookStats::Inline<IsMoviePlaying_hk>("IsMoviePlaying"));
         }
         else {
             spdlog::error("IsMoviePlaying: Pattern scan failed.");
+            bResult = false;
         }
+    }
 
-        // Remove framerate cap
-        std::uint8_t* FramerateCapScanResult = Memory::PatternScan(baseModule, "C5 ?? ?? ?? C5 ?? ?? ?? C5 ?? ?? ?? 76 ?? C5 ?? ?? ?? ?? ?? ?? ?? C5 ?? ?? ?? C4 ?? ?? ?? ?? C5 ?? ?? ?? 48 8D ?? ?? ??");
+    if ((bUncapFPS || bFrameTimes || bLODAdaptive || bTelemetry) && !FramerateCapMidHook) {
+        // Remove framerate cap, also the per-frame hook for frame time capture, the LOD governor and telemetry
+        std::uint8_t* FramerateCapScanResult = Scans.Get("Framerate Cap");
         if (FramerateCapScanResult) {
             spdlog::info("Framerate Cap: Address is {:s}+{:x}", sExeName.c_str(), FramerateCapScanResult - (std::uint8_t*)baseModule);
             // This effectively sets "MaxSmoothedFrameRate" to 0
-            static SafetyHookMid FramerateCapMidHook{};
-            FramerateCapMidHook = safetyhook::create_mid(FramerateCapScanResult,
-                [](SafetyHookContext& ctx) {
-                    if (!bIsMoviePlaying) {
-                        // Uncap framerate
-                        ctx.xmm0.f32[0] = 0.00f;
-                    }
-                });
+            Patches.MidHook(FramerateCapMidHook, FramerateCapScanResult, HookStats::Mid<FramerateCap_hk>("Framerate Cap"));
         }
         else {
             spdlog::error("Framerate Cap: Pattern scan failed.");
+            bResult = false;
         }
     }
 
-    if (bLODDistance) {
+    // Independent of the framerate cap, so either can go live without the other
+    Patches.Batch();
+
+    if (bLODDistance && !pLODDistanceFactor && !LODDistanceFactorMidHook) {
         // LOD distance
-        std::uint8_t* LODDistanceFactorScanResult = Memory::PatternScan(baseModule, "F3 0F ?? ?? ?? ?? ?? ?? 48 8D ?? ?? 49 ?? ?? E8 ?? ?? ?? ?? 48 ?? ?? 48 8D ?? ?? ?? ?? ?? E8 ?? ?? ?? ??");
+        std::uint8_t* LODDistanceFactorScanResult = Scans.Get("LOD Distance");
         if (LODDistanceFactorScanResult) {
             spdlog::info("LOD Distance: Address is {:s}+{:x}", sExeName.c_str(), LODDistanceFactorScanResult - (std::uint8_t*)baseModule);
-            static SafetyHookMid LODDistanceFactorMidHook{};
-            LODDistanceFactorMidHook = safetyhook::create_mid(LODDistanceFactorScanResult,
-                [](SafetyHookContext& ctx) {
-                    // Set "LODDistanceFactor"
-                    ctx.xmm1.f32[0] = 0.001f;
-                });
+            // The game stores "LODDistanceFactor" from xmm1 here. The mid-hook replaces xmm1 on every pass, so the code
+            // after the store sees our factor too. Optionally the store is sent elsewhere and we set the variable once,
+            // so nothing runs per frame, but that only holds while nothing else in the game writes the variable.
+            if (bLODRedirectStore)
+                pLODVariable = Memory::OverrideFloatStore(Patches, LODDistanceFactorScanResult, 1, fCurrentLODFactor);
+            if (pLODVariable) {
+                spdlog::info("LOD Distance: Redirected store, variable is at {:s}+{:x}", sExeName.c_str(), (std::uint8_t*)pLODVariable - (std::uint8_t*)baseModule);
+            }
+            else {
+                if (bLODRedirectStore)
+                    spdlog::info("LOD Distance: Store can't be redirected, using a mid-hook.");
+                Patches.MidHook(LODDistanceFactorMidHook, LODDistanceFactorScanResult, HookStats::Mid<LODDistanceFactor_hk>("LOD Distance"));
+            }
         }
         else {
             spdlog::error("LOD Distance: Pattern scan failed.");
+            bResult = false;
         }
     }
+
+    // Only ours to write once the redirect is live
+    if (pLODVariable)
+        Patches.OnCommit([pLODVariable] { pLODDistanceFactor = pLODVariable; });
+
+    return Apply(Patches, "Misc") && bResult;
 }
 
-typedef void(__thiscall* EngineExecType)(size_t, const wchar_t*, size_t);
-EngineExecType EngineExec_fn = nullptr;
+DWORD __stdcall HookStatsReport(void*)
+{
+    HookStats::Reporter reporter;
+    while (!bDetaching) {
+        Sleep(iHookStatsInterval * 1000);
+        if (bDetaching)
+            break;
+        auto summaries = reporter.Interval();
+        for (std::size_t id = 0; id < summaries.size(); ++id) {
+            const auto& stats = summaries[id];
+            spdlog::info("Hook Stats: {}: {} calls in {}s, p50 {:.0f} ns, p99 {:.0f} ns, max {:.0f} ns", stats.name, stats.calls, iHookStatsInterval, stats.p50, stats.p99, stats.max);
+            TelemetryWriter.SetHook(id, stats.name, stats.total, stats.p99, stats.max);
+        }
+    }
+    return 0;
+}
 
-std::uint8_t* GEngine = nullptr;
-size_t FOutputDevice = 0;
+void HookStatsThread()
+{
+    if (!bHookStats)
+        return;
 
-SafetyHookInline EngineExec_sh{};
-void EngineExec_hk(size_t gameEngine, const wchar_t* cmd, size_t outputDevice)
+    // Merges and logs the per-thread hook counters without competing with the game for CPU time
+    HANDLE statsHandle = CreateThread(NULL, 0, HookStatsReport, 0, CREATE_SUSPENDED, 0);
+    if (statsHandle) {
+        SetThreadPriority(statsHandle, THREAD_PRIORITY_LOWEST);
+        ResumeThread(statsHandle);
+        CloseHandle(statsHandle);
+    }
+}
+
+DWORD __stdcall FrameTimesWriter(void*)
 {
-    // GEngine
-    GEngine = (uint8_t*)gameEngine;
-    //spdlog::info("UGameEngine::Exec(): GEngine address: {:x}", (uintptr_t)GEngine);
+    // Drain several times a second so the ring never fills, summarise once per interval. The session summary in the
+    // CSV is brought up to date every interval too: the process can end without this thread getting another go, and
+    // DllMain runs under the loader lock, where writing files isn't safe.
+    constexpr int iDrainPeriod = 250;
+    for (int elapsed = iDrainPeriod; !bDetaching; elapsed += iDrainPeriod) {
+        Sleep(iDrainPeriod);
+        if (bDetaching)
+            break;
+        auto stats = FrameTimeCapture.Drain();
+        if (elapsed < iFrameTimesInterval * 1000)
+            continue;
 
-    // FOutputDevice
-    if (FOutputDevice == 0)
-        FOutputDevice = outputDevice;
+        elapsed = 0;
+        spdlog::info("Frame Times: {} frames in {}s, avg {:.1f} fps, 1% low {:.1f} fps, 0.1% low {:.1f} fps, max {:.2f} ms, {} stutters, {} dropped",
+            stats.frames, iFrameTimesInterval, stats.avgFps, stats.low1Fps, stats.low01Fps, stats.maxFrameTime, stats.stutters, FrameTimeCapture.Dropped());
+        FrameTimeCapture.Finish();
+    }
+    return 0;
+}
 
-    // Log command
-    //spdlog::info("UGameEngine::Exec(): Executed command: {}", Util::wstring_to_string(cmd));
+void FrameTimesThread()
+{
+    if (!bFrameTimes)
+        return;
 
-    // Call original function
-    EngineExec_sh.thiscall<void>(gameEngine, cmd, outputDevice);
+    std::string sFrameTimesFile = sExePath.string() + sFixName + "_frametimes.csv";
+    if (!FrameTimeCapture.Open(sFrameTimesFile)) {
+        spdlog::warn("Frame Times: Could not open {}", sFrameTimesFile);
+        return;
+    }
+    spdlog::info("Frame Times: Writing to {}", sFrameTimesFile);
+
+    HANDLE writerHandle = CreateThread(NULL, 0, FrameTimesWriter, 0, CREATE_SUSPENDED, 0);
+    if (writerHandle) {
+        SetThreadPriority(writerHandle, THREAD_PRIORITY_LOWEST);
+        ResumeThread(writerHandle);
+        CloseHandle(writerHandle);
+    }
 }
 
-void UE()
+void TrampolineArena()
 {
-    // UGameEngine::Exec()
-    std::uint8_t* EngineExecScanResult = Memory::PatternScan(baseModule, "48 89 ?? ?? ?? 55 56 57 41 ?? 41 ?? 41 ?? 41 ?? 48 8D ?? ?? ?? ?? ?? ?? 48 81 ?? ?? ?? ?? ?? 0F 29 ?? ?? ?? ?? ?? ?? 48 8B ?? ?? ?? ?? ?? 48 33 ?? 48 89 ?? ?? ?? ?? ?? 4D ?? ?? 48 ?? ?? 4C ?? ??");
-    if (EngineExecScanResult) {
-        spdlog::info("UGameEngine::Exec(): Address is {:s}+{:x}", sExeName.c_str(), EngineExecScanResult - (std::uint8_t*)baseModule);
+    Trace::Scope trace("Trampoline Arena");
+    if (!bTrampolineArena)
+        return;
 
-        EngineExec_fn = (EngineExecType)EngineExecScanResult;
-        EngineExec_sh = safetyhook::create_inline(EngineExec_fn, reinterpret_cast<void*>(EngineExec_hk));
-        if (EngineExec_sh) {
-            spdlog::info("UGameEngine::Exec(): Hooked function successfully.");
-        }
-        else {
-            spdlog::info("UGameEngine::Exec(): Failed to hook function.");
-            return;
-        }
+    // Every hook target is inside the game's image, so reserve where both ends of it are in reach of a rel32 jmp
+    HookAllocator = safetyhook::Allocator::global();
+    std::uint8_t* imageBegin = (std::uint8_t*)baseModule;
+    std::uint8_t* imageEnd = imageBegin + Scanner::ImageSize(imageBegin);
+    if (auto arena = HookAllocator->reserve({ imageBegin, imageEnd }, 64 * 1024))
+        spdlog::info("Trampoline Arena: Reserved at {:x}", (uintptr_t)*arena);
+    else
+        spdlog::warn("Trampoline Arena: Could not reserve memory near {:s}, hooks allocate their own.", sExeName.c_str());
+}
 
-        for (int attempts = 0; attempts < 30; ++attempts) {
-            if (GEngine) {
-                break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+void SealTrampolineArena()
+{
+    if (!HookAllocator)
+        return;
+
+    // Nothing writes to trampolines or stubs once they are built
+    if (HookAllocator->seal())
+        spdlog::info("Trampoline Arena: Made read-only.");
+    else
+        spdlog::warn("Trampoline Arena: Could not make hook memory read-only.");
+}
+
+DWORD __stdcall Rescanner(void*)
+{
+    SYSTEM_INFO systemInfo{};
+    GetSystemInfo(&systemInfo);
+    Rescan::Options options;
+    options.deadline = std::chrono::seconds(iRescanDeadline);
+    // Startup is over, so the rescan can stay on one core rather than compete with the game's loading threads
+    options.threads = 1;
+    Rescan::Rescanner rescanner((std::uint8_t*)baseModule, systemInfo.dwPageSize, [](Scanner::Scope scope) { return Memory::ScanBlocks(baseModule, scope); }, options);
+    rescanner.Start();
 
-        if (GEngine && FOutputDevice) {
-            EngineExec_hk((size_t)GEngine, L"stat fps", FOutputDevice);
-            EngineExec_hk((size_t)GEngine, L"stat unit", FOutputDevice);
+    bool bExpired = false;
+    while (!LateFeatures.empty() && Rescan::Missing(Scans) && !bDetaching) {
+        Sleep((DWORD)rescanner.Interval().count());
+        if (bDetaching)
+            break;
+        if (rescanner.Expired()) {
+            bExpired = true;
+            break;
         }
-        else {
-            spdlog::error("UGameEngine::Exec(): Failed to find valid GEngine address or FOutputDevice.");
+
+        auto pass = rescanner.Run(Scans);
+        if (pass.resolved.empty())
+            continue;
+
+        for (auto id : pass.resolved) {
+            const auto& entry = Scans.Entries()[id];
+            spdlog::info("Rescan: Found {} at {:s}+{:x}", entry.name, sExeName.c_str(), entry.result.address - (std::uint8_t*)baseModule);
+            if (entry.result.count > 1)
+                spdlog::warn("Rescan: {} matched {} times, using the first match.", entry.name, entry.result.count);
         }
+        SaveScanCache();
+
+        std::erase_if(LateFeatures, [](const auto& feature) {
+            if (!feature.second())
+                return false;
+            spdlog::info("Rescan: {} is now applied.", feature.first);
+            return true;
+            });
+        SealTrampolineArena();
     }
-    else {
-        spdlog::error("UGameEngine::Exec(): Pattern scan failed.");
+
+    if (!bExpired)
+        return 0;
+    for (const auto& entry : Scans.Entries()) {
+        if (!entry.result.address)
+            spdlog::warn("Rescan: Gave up on {} after {}s.", entry.name, iRescanDeadline);
     }
+    return 0;
+}
+
+void RescanThread(const Tasks::Graph& startup)
+{
+    if (!bRescan || !Rescan::Missing(Scans))
+        return;
+
+    for (const auto& task : startup.Tasks()) {
+        if (task.status == Tasks::Status::Failed)
+            LateFeatures.push_back({ task.name, task.run });
+    }
+    if (LateFeatures.empty())
+        return;
+
+    // The code a signature matches may only be unpacked or committed after we were loaded
+    spdlog::info("Rescan: {} signatures missing, rescanning changed pages for up to {}s.", Rescan::Missing(Scans), iRescanDeadline);
+    HANDLE rescanHandle = CreateThread(NULL, 0, Rescanner, 0, CREATE_SUSPENDED, 0);
+    if (rescanHandle) {
+        SetThreadPriority(rescanHandle, THREAD_PRIORITY_LOWEST);
+        ResumeThread(rescanHandle);
+        CloseHandle(rescanHandle);
+    }
+}
+
+void TelemetryChannel()
+{
+    Trace::Scope trace("Telemetry");
+    if (!bTelemetry)
+        return;
+
+    // Before any feature starts, so the block sees the first resolution and every patch
+    if (!TelemetryWriter.Create(Telemetry::Name, sFixName, sFixVer)) {
+        spdlog::warn("Telemetry: Could not create the shared memory block.");
+        return;
+    }
+    if (TelemetryWriter.TakenOver())
+        spdlog::info("Telemetry: Took over the shared memory block of a previous session.");
+    spdlog::info("Telemetry: Publishing {} bytes of shared memory as SotDFixTelemetry, version {}.", sizeof(Telemetry::Block), Telemetry::Version);
+
+    TelemetryWriter.SetFrameLimit(bUncapFPS ? fFramerateLimit : 0.00f);
+    if (bLODDistance)
+        TelemetryWriter.SetLOD(fCurrentLODFactor.load(std::memory_order_relaxed), Telemetry::LODState::Holding);
+}
+
+void StartupReport(const Tasks::Graph& startup)
+{
+    for (const auto& task : startup.Tasks()) {
+        double fStart = std::chrono::duration<double, std::milli>(task.begin - startup.Begin()).count();
+        spdlog::info("Startup: {} {} in {:.2f} ms, started at +{:.2f} ms", task.name, Tasks::StatusName(task.status), task.Milliseconds(), fStart);
+    }
+
+    if (iFirstPatchTime)
+        spdlog::info("Startup: First patch live {:.2f} ms after load, all live after {:.2f} ms.", iFirstPatchTime / 1e6, iLastPatchTime / 1e6);
+    spdlog::info("----------");
+}
+
+void StartupTrace()
+{
+    if (!bStartupTrace)
+        return;
+
+    // Timings of every phase, scan and hook from DLL load until the last hook went live
+    std::string sTraceFile = sExePath.string() + sFixName + "_trace.json";
+    if (Trace::Write(sTraceFile))
+        spdlog::info("Startup Trace: {} Written to {}", Trace::Summary(), sTraceFile);
+    else
+        spdlog::warn("Startup Trace: Could not write {}", sTraceFile);
 }
 
 DWORD __stdcall Main(void*)
 {
     Logging();
     Configuration();
-    Resolution();
-    AspectRatio();
-    FOV();
-    HUD();
-    Misc();
-    //UE();
+    TrampolineArena();
+    TelemetryChannel();
+
+    // Each feature applies its own patches as soon as what it needs is ready, so one slow feature doesn't hold up the
+    // rest. Every feature needs the signature scan, so only Display runs alongside it; the features themselves then
+    // run concurrently once it's done.
+    Tasks::Graph startup;
+    auto signatures = startup.Add("Signatures", [] { Signatures(); return true; });
+    auto display = startup.Add("Display", [] { Display(); return true; });
+    startup.Add("Resolution", Resolution, { signatures, display });
+    startup.Add("AspectRatio", AspectRatio, { signatures });
+    startup.Add("FOV", FOV, { signatures, display });
+    startup.Add("HUD", HUD, { signatures, display });
+    startup.Add("Misc", Misc, { signatures });
+    startup.Add("UE", UE, { signatures });
+    startup.Run(4);
+    // The rescanner scans on its own thread, nothing needs the scan threads after startup
+    Scanner::Pool::Instance().Stop();
+    SealTrampolineArena();
+    StartupReport(startup);
+
+    StartupTrace();
+    RescanThread(startup);
+    HookStatsThread();
+    FrameTimesThread();
+
+    // Get the whole startup log on disk now rather than at the next periodic flush
+    logger->flush();
     return true;
 }
 
@@ -436,7 +1127,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
     }
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        break;
     case DLL_PROCESS_DETACH:
+        bDetaching = true;
         break;
     }
     return TRUE;
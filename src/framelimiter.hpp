@@ -0,0 +1,150 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Frame pacing. Frames are scheduled against an absolute deadline that advances by exactly one interval per frame,
+// so oversleeping one frame is paid back on the next instead of accumulating. Waiting is a coarse OS sleep up to
+// the sleeper's slack before the deadline, then a short spin to hit it precisely.
+//
+// Clock needs "time_point Now()". Sleeper needs "void Sleep(duration)", "void Spin()" and "duration Slack()".
+// Both are members so tests can substitute a manual clock.
+namespace FrameLimiter
+{
+    struct SteadyClock
+    {
+        using duration = std::chrono::steady_clock::duration;
+        using time_point = std::chrono::steady_clock::time_point;
+
+        time_point Now() const { return std::chrono::steady_clock::now(); }
+    };
+
+    // Portable fallback. Scheduler granularity is assumed to be about a millisecond.
+    struct ThreadSleeper
+    {
+        void Sleep(std::chrono::nanoseconds duration) { std::this_thread::sleep_for(duration); }
+        void Spin() { std::this_thread::yield(); }
+        std::chrono::nanoseconds Slack() const { return std::chrono::microseconds(1500); }
+    };
+
+#if defined(_WIN32)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+    // High resolution waitable timer (Windows 10 1803+), falling back to a regular one that is only as precise as
+    // the system timer period.
+    class WaitableTimerSleeper
+    {
+    public:
+        WaitableTimerSleeper()
+        {
+            m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            m_highResolution = m_timer != NULL;
+            if (!m_timer)
+                m_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        }
+
+        ~WaitableTimerSleeper()
+        {
+            if (m_timer)
+                CloseHandle(m_timer);
+        }
+
+        WaitableTimerSleeper(const WaitableTimerSleeper&) = delete;
+        WaitableTimerSleeper& operator=(const WaitableTimerSleeper&) = delete;
+
+        void Sleep(std::chrono::nanoseconds duration)
+        {
+            // Relative due times are negative, in 100 ns units
+            LARGE_INTEGER dueTime{};
+            dueTime.QuadPart = -(duration.count() / 100);
+            if (m_timer && SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE))
+                WaitForSingleObject(m_timer, INFINITE);
+            else
+                std::this_thread::sleep_for(duration);
+        }
+
+        void Spin() { YieldProcessor(); }
+
+        std::chrono::nanoseconds Slack() const
+        {
+            return m_highResolution ? std::chrono::microseconds(700) : std::chrono::microseconds(2000);
+        }
+
+    private:
+        HANDLE m_timer = NULL;
+        bool m_highResolution = false;
+    };
+
+    using PlatformSleeper = WaitableTimerSleeper;
+#else
+    using PlatformSleeper = ThreadSleeper;
+#endif
+
+    template<typename Clock, typename Sleeper>
+    class Limiter
+    {
+    public:
+        using duration = typename Clock::duration;
+        using time_point = typename Clock::time_point;
+
+        Limiter() = default;
+        Limiter(Clock clock, Sleeper sleeper) : m_clock(std::move(clock)), m_sleeper(std::move(sleeper)) {}
+
+        // Frames per second, 0 or less for unlimited.
+        void SetTarget(double fps)
+        {
+            m_interval = fps > 0.0 ? std::chrono::duration_cast<duration>(std::chrono::duration<double>(1.0 / fps)) : duration::zero();
+            Reset();
+        }
+
+        // Forget the schedule, e.g. after frames were paced by something else for a while.
+        void Reset() { m_started = false; }
+
+        // Call once per frame. Returns once the frame is due.
+        void Wait()
+        {
+            if (m_interval <= duration::zero())
+                return;
+
+            auto now = m_clock.Now();
+            if (!m_started) {
+                m_started = true;
+                m_deadline = now + m_interval;
+                return;
+            }
+
+            if (now < m_deadline) {
+                auto remaining = m_deadline - now;
+                auto slack = std::chrono::duration_cast<duration>(m_sleeper.Slack());
+                if (remaining > slack)
+                    m_sleeper.Sleep(remaining - slack);
+                while (m_clock.Now() < m_deadline)
+                    m_sleeper.Spin();
+            }
+            else if (now - m_deadline > m_interval) {
+                // More than a frame behind (loading, alt-tab): start over instead of rushing to catch up
+                m_deadline = now;
+            }
+
+            m_deadline += m_interval;
+        }
+
+        duration Interval() const { return m_interval; }
+        Clock& GetClock() { return m_clock; }
+        Sleeper& GetSleeper() { return m_sleeper; }
+
+    private:
+        Clock m_clock{};
+        Sleeper m_sleeper{};
+        duration m_interval = duration::zero();
+        time_point m_deadline{};
+        bool m_started = false;
+    };
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame-time capture. The game thread only timestamps the frame and pushes the delta into a fixed-size
+// single-producer/single-consumer ring; a background thread drains it, streams it to a CSV file and folds the
+// samples into fixed-size histograms for summaries. If the writer falls behind, frames are dropped and counted
+// rather than waited on. Nothing grows with the length of the session.
+namespace FrameTimes
+{
+    template<typename T, std::size_t Capacity>
+    class Ring
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer only.
+        bool Push(const T& value)
+        {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == Capacity)
+                return false;
+            m_items[head & (Capacity - 1)] = value;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Returns the number of items copied to out.
+        std::size_t Pop(T* out, std::size_t max)
+        {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            auto count = (std::min)(m_head.load(std::memory_order_acquire) - tail, max);
+            for (std::size_t i = 0; i < count; ++i)
+                out[i] = m_items[(tail + i) & (Capacity - 1)];
+            m_tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+    private:
+        alignas(64) std::atomic<std::size_t> m_head{ 0 };
+        alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+        std::array<T, Capacity> m_items{};
+    };
+
+    struct Sample
+    {
+        double time;        // Seconds since the first frame
+        float frameTime;    // ms since the previous frame
+    };
+
+    struct Stats
+    {
+        std::size_t frames = 0;
+        double avgFps = 0.0;
+        double low1Fps = 0.0;       // From the 99th percentile frame time
+        double low01Fps = 0.0;      // From the 99.9th percentile frame time
+        double maxFrameTime = 0.0;  // ms
+        std::size_t stutters = 0;   // Frames taking more than twice the median
+    };
+
+    inline Stats Summarise(std::vector<float> frameTimes)
+    {
+        Stats stats;
+        stats.frames = frameTimes.size();
+        if (frameTimes.empty())
+            return stats;
+
+        double total = 0.0;
+        for (auto frameTime : frameTimes)
+            total += frameTime;
+        std::sort(frameTimes.begin(), frameTimes.end());
+
+        auto percentile = [&](double fraction) {
+            return frameTimes[(std::min)(frameTimes.size() - 1, static_cast<std::size_t>(fraction * frameTimes.size()))];
+        };
+        auto fps = [](double ms) { return ms > 0.0 ? 1000.0 / ms : 0.0; };
+
+        stats.avgFps = fps(total / frameTimes.size());
+        stats.low1Fps = fps(percentile(0.99));
+        stats.low01Fps = fps(percentile(0.999));
+        stats.maxFrameTime = frameTimes.back();
+        float stutter = 2.0f * percentile(0.50);
+        stats.stutters = frameTimes.end() - std::upper_bound(frameTimes.begin(), frameTimes.end(), stutter);
+        return stats;
+    }
+
+    // Running totals plus a log-scale histogram of frame times, 64 bins per octave from 1/16 ms to 16 s. Average and
+    // maximum are exact; percentiles and the stutter threshold are the middle of their bin, within about half a percent.
+    class Histogram
+    {
+    public:
+        void Add(float frameTime)
+        {
+            ++m_counts[Bin(frameTime)];
+            ++m_frames;
+            m_total += frameTime;
+            m_max = (std::max)(m_max, frameTime);
+        }
+
+        void Clear()
+        {
+            m_counts.fill(0);
+            m_frames = 0;
+            m_total = 0.0;
+            m_max = 0.0f;
+        }
+
+        Stats Summarise() const
+        {
+            Stats stats;
+            stats.frames = m_frames;
+            if (!m_frames)
+                return stats;
+
+            auto fps = [](double ms) { return ms > 0.0 ? 1000.0 / ms : 0.0; };
+            auto percentile = [&](double fraction) { return (std::min)(Value(PercentileBin(fraction)), static_cast<double>(m_max)); };
+
+            stats.avgFps = fps(m_total / m_frames);
+            stats.low1Fps = fps(percentile(0.99));
+            stats.low01Fps = fps(percentile(0.999));
+            stats.maxFrameTime = m_max;
+
+            // Twice the median is exactly one octave up
+            for (std::size_t bin = PercentileBin(0.50) + BinsPerOctave + 1; bin < Bins; ++bin)
+                stats.stutters += m_counts[bin];
+            return stats;
+        }
+
+    private:
+        static constexpr int BinsPerOctave = 64;
+        static constexpr int Octaves = 18;
+        static constexpr std::size_t Bins = BinsPerOctave * Octaves;
+        static constexpr double Smallest = 1.0 / 16.0;  // ms
+
+        static std::size_t Bin(float frameTime)
+        {
+            if (!(frameTime > Smallest))
+                return 0;
+            return (std::min)(Bins - 1, static_cast<std::size_t>(std::log2(frameTime / Smallest) * BinsPerOctave));
+        }
+
+        static double Value(std::size_t bin) { return Smallest * std::exp2((bin + 0.5) / BinsPerOctave); }
+
+        // Bin holding the frame at this fraction of the session, sorted by frame time
+        std::size_t PercentileBin(double fraction) const
+        {
+            auto rank = (std::min)(m_frames - 1, static_cast<std::size_t>(fraction * m_frames));
+            std::size_t seen = 0;
+            for (std::size_t bin = 0; bin < Bins; ++bin) {
+                seen += m_counts[bin];
+                if (seen > rank)
+                    return bin;
+            }
+            return Bins - 1;
+        }
+
+        std::array<std::uint32_t, Bins> m_counts{};
+        std::size_t m_frames = 0;
+        double m_total = 0.0;
+        float m_max = 0.0f;
+    };
+
+    class Capture
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        ~Capture()
+        {
+            if (m_file)
+                std::fclose(m_file);
+        }
+
+        bool Open(const std::string& path)
+        {
+            m_file = std::fopen(path.c_str(), "w");
+            if (!m_file)
+                return false;
+            std::fputs("frame,time_s,frametime_ms\n", m_file);
+            return true;
+        }
+
+        // Game thread, once per frame. No allocation, locking or I/O.
+        void Record()
+        {
+            auto now = Clock::now();
+            if (m_started) {
+                Sample sample{ std::chrono::duration<double>(now - m_first).count(), std::chrono::duration<float, std::milli>(now - m_previous).count() };
+                if (!m_ring.Push(sample))
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                m_started = true;
+                m_first = now;
+            }
+            m_previous = now;
+        }
+
+        // Writer thread. Streams everything recorded so far to the file and returns the summary of the frames
+        // drained since the previous call.
+        Stats Drain()
+        {
+            std::scoped_lock lock{ m_mutex };
+            m_interval.Clear();
+            DrainLocked();
+            return m_interval.Summarise();
+        }
+
+        // Writer thread. Summary of the session so far, also appended to the file as a "#" line. The process can end
+        // at any time without notice, so the writer calls this once per interval: the last "#" line covers the session
+        // up to the last interval.
+        Stats Finish()
+        {
+            std::scoped_lock lock{ m_mutex };
+            DrainLocked();
+            auto stats = m_session.Summarise();
+            if (m_file) {
+                std::fprintf(m_file, "# %zu frames, avg %.1f fps, 1%% low %.1f fps, 0.1%% low %.1f fps, max %.2f ms, %zu stutters, %zu dropped\n",
+                    stats.frames, stats.avgFps, stats.low1Fps, stats.low01Fps, stats.maxFrameTime, stats.stutters, Dropped());
+                std::fflush(m_file);
+            }
+            return stats;
+        }
+
+        std::size_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        void DrainLocked()
+        {
+            while (auto count = m_ring.Pop(m_batch.data(), m_batch.size())) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    const auto& sample = m_batch[i];
+                    if (m_file)
+                        std::fprintf(m_file, "%zu,%.6f,%.3f\n", ++m_frames, sample.time, sample.frameTime);
+                    m_interval.Add(sample.frameTime);
+                    m_session.Add(sample.frameTime);
+                }
+            }
+            if (m_file)
+                std::fflush(m_file);
+        }
+
+        // About a minute at 144 fps, the writer drains it several times a second
+        Ring<Sample, 8192> m_ring;
+        std::atomic<std::size_t> m_dropped{ 0 };
+
+        // Game thread
+        bool m_started = false;
+        Clock::time_point m_first{};
+        Clock::time_point m_previous{};
+
+        // Writer thread
+        std::mutex m_mutex;
+        std::FILE* m_file = nullptr;
+        std::array<Sample, 512> m_batch{};
+        std::size_t m_frames = 0;
+        Histogram m_interval;
+        Histogram m_session;
+    };
+}
@@ -1,4 +1,7 @@
 #include "stdafx.h"
+#include "scanner.hpp"
+#include "rescan.hpp"
+#include "trace.hpp"
 
 namespace Memory
 {
@@ -19,75 +22,98 @@ namespace Memory
         VirtualProtect((LPVOID)address, numBytes, oldProtect, &oldProtect);
     }
 
-    // CSGOSimple's pattern scan
-    // https://github.com/OneshotGH/CSGOSimple-master/blob/master/CSGOSimple/helpers/utils.cpp
-    std::uint8_t* PatternScan(void* module, const char* signature)
+    // The committed, readable parts of [offset, offset + size) of the module, one block per VirtualQuery region.
+    std::vector<Rescan::Block> CommittedBlocks(void* module, std::size_t offset, std::size_t size)
     {
-        static auto pattern_to_byte = [](const char* pattern) {
-            auto bytes = std::vector<int>{};
-            auto start = const_cast<char*>(pattern);
-            auto end = const_cast<char*>(pattern) + strlen(pattern);
-
-            for (auto current = start; current < end; ++current) {
-                if (*current == '?') {
-                    ++current;
-                    if (*current == '?')
-                        ++current;
-                    bytes.push_back(-1);
-                }
-                else {
-                    bytes.push_back(strtoul(current, &current, 16));
-                }
-            }
-            return bytes;
-            };
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto end = base + offset + size;
+        std::vector<Rescan::Block> blocks;
+        MEMORY_BASIC_INFORMATION mbi{};
+
+        for (auto address = base + offset; address < end; address = (std::uint8_t*)mbi.BaseAddress + mbi.RegionSize) {
+            if (!VirtualQuery(address, &mbi, sizeof(mbi)))
+                break;
+
+            auto regionEnd = (std::min)((std::uint8_t*)mbi.BaseAddress + mbi.RegionSize, end);
+            if (mbi.State != MEM_COMMIT || (mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+                continue;
+            blocks.push_back({ (std::size_t)(address - base), (std::size_t)(regionEnd - address), (std::uint32_t)mbi.Protect });
+        }
+        return blocks;
+    }
 
-        auto dosHeader = (PIMAGE_DOS_HEADER)module;
-        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
+    // Splits [offset, offset + size) of the module into the committed, readable parts, so reserved gaps and guard
+    // pages are never touched by a scan. Parts are merged across protection changes so matches spanning one are still
+    // found.
+    std::vector<Scanner::Region> CommittedRegions(void* module, std::size_t offset, std::size_t size)
+    {
+        return Rescan::Merge(CommittedBlocks(module, offset, size));
+    }
 
-        auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
-        auto patternBytes = pattern_to_byte(signature);
+    // Blocks of the module that a signature with the given scope is searched in.
+    std::vector<Rescan::Block> ScanBlocks(void* module, Scanner::Scope scope)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        if (scope == Scanner::Scope::Image)
+            return CommittedBlocks(module, 0, Scanner::ImageSize(base));
+
+        std::vector<Rescan::Block> blocks;
+        for (const auto& section : Scanner::ExecutableRegions(base)) {
+            auto committed = CommittedBlocks(module, section.offset, section.size);
+            blocks.insert(blocks.end(), committed.begin(), committed.end());
+        }
+        return blocks;
+    }
+
+    // Regions of the module that a signature with the given scope is searched in.
+    std::vector<Scanner::Region> ScanRegions(void* module, Scanner::Scope scope)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        if (scope == Scanner::Scope::Image)
+            return CommittedRegions(module, 0, Scanner::ImageSize(base));
+
+        std::vector<Scanner::Region> regions;
+        for (const auto& section : Scanner::ExecutableRegions(base)) {
+            auto committed = CommittedRegions(module, section.offset, section.size);
+            regions.insert(regions.end(), committed.begin(), committed.end());
+        }
+        return regions;
+    }
+
+    // First match in the module. By default only executable sections are searched.
+    std::uint8_t* PatternScan(void* module, const Scanner::PatternView& pattern, Scanner::Scope scope = Scanner::Scope::Executable)
+    {
+        Trace::Scope trace("PatternScan", "scan");
         auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+        auto regions = ScanRegions(module, scope);
+        auto match = const_cast<std::uint8_t*>(Scanner::Find(scanBytes, regions, pattern));
+
+        std::size_t scannedBytes = 0;
+        for (const auto& region : regions)
+            scannedBytes += region.size;
+        trace.Arg("bytes", scannedBytes);
+        trace.Arg("matches", match ? 1 : 0);
+        return match;
+    }
 
-        auto s = patternBytes.size();
-        auto d = patternBytes.data();
+    std::uint8_t* PatternScan(void* module, const char* signature, Scanner::Scope scope = Scanner::Scope::Executable)
+    {
+        auto pattern = Scanner::Parse(signature);
+        return PatternScan(module, pattern.View(), scope);
+    }
 
-        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-            bool found = true;
-            for (auto j = 0ul; j < s; ++j) {
-                if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                    found = false;
-                    break;
-                }
-            }
-            if (found) {
-                return &scanBytes[i];
-            }
+    // Checks that the signature still matches at "offset", e.g. to validate an offset cached from a previous run.
+    bool SignatureAt(void* module, std::size_t offset, const Scanner::PatternView& pattern, Scanner::Scope scope = Scanner::Scope::Executable)
+    {
+        for (const auto& region : ScanRegions(module, scope)) {
+            if (offset >= region.offset && offset + pattern.size <= region.offset + region.size)
+                return Scanner::Matches(reinterpret_cast<std::uint8_t*>(module) + offset, pattern);
         }
-        return nullptr;
+        return false;
     }
 
-    // CSGOSimple's pattern scan. Adapted to return a vector containing all results.
+    // Returns every match of every pattern, in pattern order.
     std::vector<std::uint8_t*> MultiPatternScan(void* module, const std::vector<std::string>& patterns) {
-        static auto pattern_to_byte = [](const char* pattern) {
-            auto bytes = std::vector<int>{};
-            auto start = const_cast<char*>(pattern);
-            auto end = const_cast<char*>(pattern) + strlen(pattern);
-
-            for (auto current = start; current < end; ++current) {
-                if (*current == '?') {
-                    ++current;
-                    if (*current == '?')
-                        ++current;
-                    bytes.push_back(-1);
-                }
-                else {
-                    bytes.push_back(strtoul(current, &current, 16));
-                }
-            }
-            return bytes;
-            };
-
         auto dosHeader = (PIMAGE_DOS_HEADER)module;
         auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
 
@@ -96,27 +122,45 @@ namespace Memory
 
         std::vector<std::uint8_t*> allMatches;
 
-        for (const auto& pattern : patterns) {
-            auto patternBytes = pattern_to_byte(pattern.c_str());
-            auto s = patternBytes.size();
-            auto d = patternBytes.data();
-
-            for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-                bool found = true;
-                for (auto j = 0ul; j < s; ++j) {
-                    if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                        found = false;
-                        break;
-                    }
-                }
-                if (found) {
-                    allMatches.push_back(&scanBytes[i]);
-                }
-            }
+        for (const auto& signature : patterns) {
+            auto pattern = Scanner::Parse(signature.c_str());
+            for (auto match : Scanner::FindAll(scanBytes, sizeOfImage - 1, pattern.View()))
+                allMatches.push_back(const_cast<std::uint8_t*>(match));
         }
         return allMatches;
     }
 
+    // Finds every signature registered with the scanner in one pass over the regions they need.
+    void SignatureScan(void* module, Scanner::MultiScanner& scanner)
+    {
+        Trace::Scope trace("SignatureScan", "scan");
+        auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+        auto executableRegions = ScanRegions(module, Scanner::Scope::Executable);
+        auto imageRegions = ScanRegions(module, Scanner::Scope::Image);
+
+        // Only the scopes that still have unresolved signatures are swept
+        std::vector<std::size_t> pending;
+        std::size_t scannedBytes = 0;
+        bool bScopeSwept[2] = {};
+        for (std::size_t id = 0; id < scanner.Entries().size(); ++id) {
+            const auto& entry = scanner.Entries()[id];
+            if (entry.resolved)
+                continue;
+            pending.push_back(id);
+            if (!bScopeSwept[entry.scope == Scanner::Scope::Image]) {
+                bScopeSwept[entry.scope == Scanner::Scope::Image] = true;
+                for (const auto& region : entry.scope == Scanner::Scope::Image ? imageRegions : executableRegions)
+                    scannedBytes += region.size;
+            }
+        }
+
+        scanner.Scan(scanBytes, executableRegions, imageRegions);
+
+        trace.Arg("bytes", scannedBytes);
+        for (auto id : pending)
+            trace.Arg(scanner.Entries()[id].name, scanner.Entries()[id].result.count);
+    }
+
     static HMODULE GetThisDllHandle()
     {
         MEMORY_BASIC_INFORMATION info;
@@ -161,4 +205,12 @@ namespace Util
         wcstombs_s(&converted, &str[0], str.size() + 1, wstr, str.size());
         return str;
     }
+
+    std::wstring string_to_wstring(const std::string& str)
+    {
+        int len = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), nullptr, 0);
+        std::wstring wstr(len, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), &wstr[0], len);
+        return wstr;
+    }
 }
\ No newline at end of file
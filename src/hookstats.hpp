@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <safetyhook.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Call counts and latency histograms for hook callbacks.
+//
+// Whether a callback is instrumented is decided when it is installed: Mid<Callback>() and Inline<Function>() hand
+// back either the callback itself or a wrapper that times it, so with stats disabled the hook runs exactly the code
+// it always did. Each thread writes its own counters with plain relaxed stores; a reporter merges them.
+namespace HookStats
+{
+    inline constexpr std::size_t MaxHooks = 16;
+    inline constexpr std::size_t Buckets = 64;
+
+    // Set from the config before any hook is installed
+    inline bool Enabled = false;
+
+    inline std::uint64_t Cycles()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Counters of one thread. Only that thread writes them.
+    struct ThreadStats
+    {
+        std::array<std::atomic<std::uint64_t>, MaxHooks> calls{};
+        std::array<std::atomic<std::uint64_t>, MaxHooks> maxCycles{};
+        std::array<std::array<std::atomic<std::uint64_t>, Buckets>, MaxHooks> buckets{};   // log2(cycles)
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<const char*> names;
+        std::vector<ThreadStats*> threads;  // Never freed, a reporter may be reading them
+    };
+
+    inline Registry& Instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    inline std::size_t Register(const char* name)
+    {
+        auto& registry = Instance();
+        std::scoped_lock lock{ registry.mutex };
+        if (registry.names.size() == MaxHooks)
+            return MaxHooks;
+        registry.names.push_back(name);
+        return registry.names.size() - 1;
+    }
+
+    inline ThreadStats& Local()
+    {
+        thread_local ThreadStats* stats = [] {
+            auto stats = new ThreadStats();
+            auto& registry = Instance();
+            std::scoped_lock lock{ registry.mutex };
+            registry.threads.push_back(stats);
+            return stats;
+            }();
+        return *stats;
+    }
+
+    inline void Record(std::size_t id, std::uint64_t cycles)
+    {
+        if (id >= MaxHooks)
+            return;
+
+        auto& stats = Local();
+        auto bump = [](std::atomic<std::uint64_t>& counter) { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); };
+        bump(stats.calls[id]);
+        bump(stats.buckets[id][(std::min<std::size_t>)(std::bit_width(cycles), Buckets - 1)]);
+        if (cycles > stats.maxCycles[id].load(std::memory_order_relaxed))
+            stats.maxCycles[id].store(cycles, std::memory_order_relaxed);
+    }
+
+    // Id of each instrumented callback, assigned when it is installed
+    template<auto Callback>
+    inline std::size_t Id = MaxHooks;
+
+    template<auto Callback>
+    void InstrumentedMid(SafetyHookContext& ctx)
+    {
+        auto begin = Cycles();
+        Callback(ctx);
+        Record(Id<Callback>, Cycles() - begin);
+    }
+
+    template<auto Callback, typename Context>
+    void InstrumentedSlimCall(Context& ctx)
+    {
+        auto begin = Cycles();
+        Callback(ctx);
+        Record(Id<Callback>, Cycles() - begin);
+    }
+
+    template<auto Callback, typename Context>
+    auto InstrumentedSlim(void (*)(Context&))
+    {
+        return &InstrumentedSlimCall<Callback, Context>;
+    }
+
+    template<auto Function, typename Return, typename... Args>
+    Return InstrumentedCall(Args... args)
+    {
+        auto begin = Cycles();
+        if constexpr (std::is_void_v<Return>) {
+            Function(args...);
+            Record(Id<Function>, Cycles() - begin);
+        }
+        else {
+            Return result = Function(args...);
+            Record(Id<Function>, Cycles() - begin);
+            return result;
+        }
+    }
+
+    template<auto Function, typename Return, typename... Args>
+    void* InstrumentedInline(Return (*)(Args...))
+    {
+        return reinterpret_cast<void*>(&InstrumentedCall<Function, Return, Args...>);
+    }
+
+    // Callback for a mid-hook, timed if stats are enabled.
+    template<safetyhook::MidHookFn Callback>
+    safetyhook::MidHookFn Mid(const char* name)
+    {
+        if (!Enabled)
+            return Callback;
+        Id<Callback> = Register(name);
+        return &InstrumentedMid<Callback>;
+    }
+
+    // Callback for a slim hook, timed if stats are enabled.
+    template<auto Callback>
+    decltype(Callback) Slim(const char* name)
+    {
+        if (!Enabled)
+            return Callback;
+        Id<Callback> = Register(name);
+        return InstrumentedSlim<Callback>(Callback);
+    }
+
+    // Destination for an inline hook, timed if stats are enabled.
+    template<auto Function>
+    void* Inline(const char* name)
+    {
+        if (!Enabled)
+            return reinterpret_cast<void*>(Function);
+        Id<Function> = Register(name);
+        return InstrumentedInline<Function>(Function);
+    }
+
+    struct Summary
+    {
+        const char* name;
+        std::uint64_t calls;    // Since the previous report
+        std::uint64_t total;    // Since startup
+        double p50;             // Upper bound of the log2 bucket, ns
+        double p99;
+        double max;             // Since startup, ns
+    };
+
+    // Merges every thread's counters and reports the change since the previous call.
+    class Reporter
+    {
+    public:
+        Reporter()
+        {
+            // Calibrate the TSC against the steady clock
+            auto clockBegin = std::chrono::steady_clock::now();
+            auto cyclesBegin = Cycles();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - clockBegin).count();
+            m_nsPerCycle = ns / (std::max<std::uint64_t>)(1, Cycles() - cyclesBegin);
+        }
+
+        std::vector<Summary> Interval()
+        {
+            auto& registry = Instance();
+            std::vector<const char*> names;
+            std::vector<ThreadStats*> threads;
+            {
+                std::scoped_lock lock{ registry.mutex };
+                names = registry.names;
+                threads = registry.threads;
+            }
+
+            std::vector<Summary> summaries;
+            for (std::size_t id = 0; id < names.size(); ++id) {
+                Totals totals{};
+                for (auto stats : threads) {
+                    totals.calls += stats->calls[id].load(std::memory_order_relaxed);
+                    totals.maxCycles = (std::max)(totals.maxCycles, stats->maxCycles[id].load(std::memory_order_relaxed));
+                    for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+                        totals.buckets[bucket] += stats->buckets[id][bucket].load(std::memory_order_relaxed);
+                }
+
+                Totals& last = m_last[id];
+                Totals delta{};
+                delta.calls = totals.calls - last.calls;
+                for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+                    delta.buckets[bucket] = totals.buckets[bucket] - last.buckets[bucket];
+                last = totals;
+
+                summaries.push_back({ names[id], delta.calls, totals.calls, Percentile(delta, 0.50), Percentile(delta, 0.99), totals.maxCycles * m_nsPerCycle });
+            }
+            return summaries;
+        }
+
+    private:
+        struct Totals
+        {
+            std::uint64_t calls;
+            std::uint64_t maxCycles;
+            std::array<std::uint64_t, Buckets> buckets;
+        };
+
+        double Percentile(const Totals& totals, double fraction) const
+        {
+            std::uint64_t calls = 0;
+            for (auto count : totals.buckets)
+                calls += count;
+            if (!calls)
+                return 0.0;
+
+            std::uint64_t seen = 0;
+            for (std::size_t bucket = 0; bucket < Buckets; ++bucket) {
+                seen += totals.buckets[bucket];
+                if (seen >= fraction * calls)
+                    return static_cast<double>(bucket ? (1ull << bucket) - 1 : 0) * m_nsPerCycle;
+            }
+            return 0.0;
+        }
+
+        double m_nsPerCycle = 1.0;
+        std::array<Totals, MaxHooks> m_last{};
+    };
+}
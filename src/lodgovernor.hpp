@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Closed-loop LOD distance. Fed one frame time per frame, it moves the LOD distance factor between a minimum
+// (most detail) and a maximum (least detail) to hold a target frame time.
+//
+// Frame times are smoothed with an exponential moving average and nothing changes while the average is within a
+// band around the target, so a single slow frame or a target sitting right on the edge doesn't make LODs pop.
+// Outside the band the factor moves geometrically, at a rate set in doublings per second, because useful values
+// span several orders of magnitude.
+namespace LOD
+{
+    struct GovernorConfig
+    {
+        float fTargetFrameTime = 16.67f;    // ms
+        float fMinFactor = 0.001f;
+        float fMaxFactor = 1.00f;
+        float fHysteresis = 0.10f;          // Fraction of the target either side that counts as on target
+        float fSmoothing = 0.05f;           // EMA weight of the newest frame
+        float fRate = 1.00f;                // Doublings (or halvings) per second of frame time while off target
+    };
+
+    class Governor
+    {
+    public:
+        enum class State { Holding, Raising, Lowering };   // Raising = more detail
+
+        explicit Governor(const GovernorConfig& config = {}) : m_config(config)
+        {
+            m_config.fMaxFactor = (std::max)(m_config.fMaxFactor, m_config.fMinFactor);
+            m_fFactor = m_config.fMinFactor;
+            m_fAverage = m_config.fTargetFrameTime;
+        }
+
+        // Returns the factor to use from now on.
+        float Update(float fFrameTime)
+        {
+            // Ignore hitches (loading, alt-tab) entirely, they say nothing about rendering cost
+            if (!(fFrameTime > 0.00f) || fFrameTime > 10 * m_config.fTargetFrameTime)
+                return m_fFactor;
+
+            m_fAverage += m_config.fSmoothing * (fFrameTime - m_fAverage);
+
+            float fBand = m_config.fTargetFrameTime * m_config.fHysteresis;
+            if (m_fAverage > m_config.fTargetFrameTime + fBand)
+                m_state = State::Lowering;
+            else if (m_fAverage < m_config.fTargetFrameTime - fBand)
+                m_state = State::Raising;
+            else
+                m_state = State::Holding;
+
+            if (m_state != State::Holding) {
+                float fStep = exp2f(m_config.fRate * fFrameTime / 1000.00f);
+                float fFactor = m_state == State::Lowering ? m_fFactor * fStep : m_fFactor / fStep;
+                m_fFactor = std::clamp(fFactor, m_config.fMinFactor, m_config.fMaxFactor);
+            }
+            return m_fFactor;
+        }
+
+        float Factor() const { return m_fFactor; }
+        float AverageFrameTime() const { return m_fAverage; }
+        State GetState() const { return m_state; }
+
+    private:
+        GovernorConfig m_config;
+        float m_fFactor;
+        float m_fAverage;
+        State m_state = State::Holding;
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "transaction.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include <safetyhook.hpp>
+#include <Zydis.h>
+
+// Hookless overrides of values the game stores from a register.
+//
+// A mid-hook that only puts a constant into the register an instruction is about to store costs a full context save
+// and restore every time it runs. When that instruction stores to a RIP-relative variable, the same effect can be had
+// for free: point the store at a scratch float of our own and write the value into the game's variable ourselves.
+// That is only equivalent while the instruction is the variable's only writer and nothing after it relies on the
+// register holding the value, which the caller has to know. The register is left as the game computed it.
+namespace Memory
+{
+    // "movss [rip+disp32], xmmN" or its VEX form, decoded.
+    struct FloatStore
+    {
+        std::uint8_t* instruction = nullptr;
+        std::size_t length = 0;
+        std::size_t dispOffset = 0;     // Offset of the disp32 field in the instruction
+        float* variable = nullptr;      // What the instruction writes to
+        int xmmRegister = 0;
+    };
+
+    inline std::optional<FloatStore> DecodeFloatStore(std::uint8_t* address)
+    {
+        // Same per-thread decoder safetyhook creates the hooks with.
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        if (!safetyhook::decode_full(&instruction, operands, address))
+            return std::nullopt;
+
+        if (instruction.mnemonic != ZYDIS_MNEMONIC_MOVSS && instruction.mnemonic != ZYDIS_MNEMONIC_VMOVSS)
+            return std::nullopt;
+        if (instruction.operand_count_visible != 2 || instruction.raw.disp.size != 32)
+            return std::nullopt;
+
+        const auto& destination = operands[0];
+        const auto& source = operands[1];
+        if (destination.type != ZYDIS_OPERAND_TYPE_MEMORY || destination.mem.base != ZYDIS_REGISTER_RIP || destination.mem.index != ZYDIS_REGISTER_NONE)
+            return std::nullopt;
+        if (source.type != ZYDIS_OPERAND_TYPE_REGISTER || source.reg.value < ZYDIS_REGISTER_XMM0 || source.reg.value > ZYDIS_REGISTER_XMM15)
+            return std::nullopt;
+
+        FloatStore store;
+        store.instruction = address;
+        store.length = instruction.length;
+        store.dispOffset = instruction.raw.disp.offset;
+        store.variable = reinterpret_cast<float*>(address + instruction.length + instruction.raw.disp.value);
+        store.xmmRegister = source.reg.value - ZYDIS_REGISTER_XMM0;
+        return store;
+    }
+
+    // Stages the patches that make the float store at "address" leave the game's variable to us, if the instruction
+    // stores xmm"xmmRegister" to a RIP-relative variable. The variable is set to "value" when the transaction commits
+    // and can be written directly afterwards. Returns nullptr if the instruction doesn't allow it, a mid-hook is needed.
+    inline float* OverrideFloatStore(Transaction& transaction, std::uint8_t* address, int xmmRegister, float value)
+    {
+        auto store = DecodeFloatStore(address);
+        if (!store || store->xmmRegister != xmmRegister)
+            return nullptr;
+
+        // The scratch float has to be within reach of a disp32 from the instruction. Never freed, the game keeps
+        // writing to it, so it is leaked once it is known to be in reach and goes back to the allocator otherwise.
+        // Kept out of the hook allocator, whose memory is made read-only once the hooks are in.
+        static auto dataAllocator = safetyhook::Allocator::create();
+        auto allocation = dataAllocator->allocate_near({ address }, sizeof(float));
+        if (!allocation)
+            return nullptr;
+
+        auto displacement = reinterpret_cast<std::intptr_t>(allocation->data()) - reinterpret_cast<std::intptr_t>(address + store->length);
+        if (displacement < INT32_MIN || displacement > INT32_MAX)
+            return nullptr;
+        new safetyhook::Allocation(std::move(*allocation));
+
+        transaction.Write<std::int32_t>(address + store->dispOffset, static_cast<std::int32_t>(displacement));
+        transaction.Write<float>(reinterpret_cast<std::uint8_t*>(store->variable), value);
+        return store->variable;
+    }
+}
@@ -0,0 +1,650 @@
+#pragma once
+
+// The part of the Win32 API the fix uses.
+//
+// On Windows this is windows.h and nothing else. Elsewhere the same names are implemented on POSIX, enough for
+// tools/Harness.cpp to run the fix's whole startup against a PE image mapped into a Linux process: memory protection
+// and queries, the main module and its PE headers, the desktop resolution, threads, named shared memory and string
+// conversion. What the harness controls (which image is the main module, module paths, the desktop) lives in namespace Platform.
+#if defined(_WIN32)
+#include <windows.h>
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define WINAPI
+#define APIENTRY
+#define __stdcall
+#define __thiscall
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define _MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define CP_UTF8 65001
+
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define PAGE_WRITECOPY 0x08
+#define PAGE_EXECUTE 0x10
+#define PAGE_EXECUTE_READ 0x20
+#define PAGE_EXECUTE_READWRITE 0x40
+#define PAGE_EXECUTE_WRITECOPY 0x80
+#define PAGE_GUARD 0x100
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_FREE 0x10000
+
+#define FILE_MAP_WRITE 0x2
+#define FILE_MAP_READ 0x4
+#define FILE_MAP_ALL_ACCESS 0xF001F
+#define INVALID_HANDLE_VALUE ((HANDLE)(std::intptr_t)-1)
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_ALREADY_EXISTS 183L
+
+#define CREATE_SUSPENDED 0x4
+#define THREAD_PRIORITY_LOWEST -2
+#define THREAD_PRIORITY_BELOW_NORMAL -1
+#define THREAD_PRIORITY_NORMAL 0
+#define THREAD_PRIORITY_TIME_CRITICAL 15
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+#define ENUM_CURRENT_SETTINGS ((DWORD)-1)
+#define IMAGE_DOS_SIGNATURE 0x5A4D
+#define IMAGE_NT_SIGNATURE 0x00004550
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES 16
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YieldProcessor() __builtin_ia32_pause()
+#else
+#define YieldProcessor() ((void)0)
+#endif
+
+typedef std::uint8_t BYTE;
+typedef std::uint16_t WORD;
+typedef std::uint32_t DWORD;
+typedef std::int32_t LONG;
+typedef std::uint64_t ULONGLONG;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef std::size_t SIZE_T;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef void* HANDLE;
+typedef HANDLE HMODULE;
+typedef wchar_t WCHAR;
+typedef const wchar_t* LPCWSTR;
+typedef struct _SECURITY_ATTRIBUTES* LPSECURITY_ATTRIBUTES;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+
+struct MEMORY_BASIC_INFORMATION
+{
+    LPVOID BaseAddress;
+    LPVOID AllocationBase;
+    DWORD AllocationProtect;
+    SIZE_T RegionSize;
+    DWORD State;
+    DWORD Protect;
+    DWORD Type;
+};
+
+struct SYSTEM_INFO
+{
+    DWORD dwPageSize;
+    LPVOID lpMinimumApplicationAddress;
+    LPVOID lpMaximumApplicationAddress;
+    DWORD dwNumberOfProcessors;
+    DWORD dwAllocationGranularity;
+};
+
+struct DEVMODE
+{
+    WORD dmSize = 0;
+    DWORD dmPelsWidth = 0;
+    DWORD dmPelsHeight = 0;
+};
+
+struct IMAGE_DOS_HEADER
+{
+    WORD e_magic;
+    WORD e_cblp;
+    WORD e_cp;
+    WORD e_crlc;
+    WORD e_cparhdr;
+    WORD e_minalloc;
+    WORD e_maxalloc;
+    WORD e_ss;
+    WORD e_sp;
+    WORD e_csum;
+    WORD e_ip;
+    WORD e_cs;
+    WORD e_lfarlc;
+    WORD e_ovno;
+    WORD e_res[4];
+    WORD e_oemid;
+    WORD e_oeminfo;
+    WORD e_res2[10];
+    LONG e_lfanew;
+};
+
+struct IMAGE_FILE_HEADER
+{
+    WORD Machine;
+    WORD NumberOfSections;
+    DWORD TimeDateStamp;
+    DWORD PointerToSymbolTable;
+    DWORD NumberOfSymbols;
+    WORD SizeOfOptionalHeader;
+    WORD Characteristics;
+};
+
+struct IMAGE_DATA_DIRECTORY
+{
+    DWORD VirtualAddress;
+    DWORD Size;
+};
+
+struct IMAGE_OPTIONAL_HEADER64
+{
+    WORD Magic;
+    BYTE MajorLinkerVersion;
+    BYTE MinorLinkerVersion;
+    DWORD SizeOfCode;
+    DWORD SizeOfInitializedData;
+    DWORD SizeOfUninitializedData;
+    DWORD AddressOfEntryPoint;
+    DWORD BaseOfCode;
+    ULONGLONG ImageBase;
+    DWORD SectionAlignment;
+    DWORD FileAlignment;
+    WORD MajorOperatingSystemVersion;
+    WORD MinorOperatingSystemVersion;
+    WORD MajorImageVersion;
+    WORD MinorImageVersion;
+    WORD MajorSubsystemVersion;
+    WORD MinorSubsystemVersion;
+    DWORD Win32VersionValue;
+    DWORD SizeOfImage;
+    DWORD SizeOfHeaders;
+    DWORD CheckSum;
+    WORD Subsystem;
+    WORD DllCharacteristics;
+    ULONGLONG SizeOfStackReserve;
+    ULONGLONG SizeOfStackCommit;
+    ULONGLONG SizeOfHeapReserve;
+    ULONGLONG SizeOfHeapCommit;
+    DWORD LoaderFlags;
+    DWORD NumberOfRvaAndSizes;
+    IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+};
+
+struct IMAGE_NT_HEADERS64
+{
+    DWORD Signature;
+    IMAGE_FILE_HEADER FileHeader;
+    IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+};
+
+static_assert(sizeof(IMAGE_DOS_HEADER) == 64 && sizeof(IMAGE_FILE_HEADER) == 20 && sizeof(IMAGE_NT_HEADERS64) == 264);
+
+typedef IMAGE_DOS_HEADER* PIMAGE_DOS_HEADER;
+typedef IMAGE_NT_HEADERS64 IMAGE_NT_HEADERS;
+typedef IMAGE_NT_HEADERS64* PIMAGE_NT_HEADERS;
+
+namespace Platform
+{
+    // Set by the harness before the fix starts.
+    inline HMODULE MainModule = nullptr;
+    inline DWORD DesktopWidth = 0;
+    inline DWORD DesktopHeight = 0;
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<HMODULE, std::filesystem::path> modulePaths;
+        std::map<LPCVOID, SIZE_T> views;    // MapViewOfFile results and their sizes
+    };
+
+    inline Registry& Instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // Path GetModuleFileNameW reports for a module.
+    inline void SetModulePath(HMODULE module, const std::filesystem::path& path)
+    {
+        auto& registry = Instance();
+        std::scoped_lock lock{ registry.mutex };
+        registry.modulePaths[module] = path;
+    }
+
+    // Base of everything a HANDLE points to, so CloseHandle can free any of them.
+    struct Object
+    {
+        virtual ~Object() = default;
+    };
+
+    struct Thread : Object
+    {
+        LPTHREAD_START_ROUTINE start = nullptr;
+        LPVOID parameter = nullptr;
+        bool bStarted = false;
+
+        void Start()
+        {
+            bStarted = true;
+            std::thread(start, parameter).detach();
+        }
+    };
+
+    // A named shared memory object. Like on Windows the name goes away with the handle of whoever created it, a
+    // process that still has a view keeps its memory.
+    struct FileMapping : Object
+    {
+        int fd = -1;
+        std::string name;
+        bool bCreated = false;
+
+        ~FileMapping() override
+        {
+            if (fd >= 0)
+                close(fd);
+            if (bCreated)
+                shm_unlink(name.c_str());
+        }
+    };
+
+    inline thread_local DWORD LastError = ERROR_SUCCESS;
+
+    // Local\Name or Global\Name to /Name. Names are ASCII.
+    inline std::string SharedMemoryName(LPCWSTR name)
+    {
+        std::wstring wide = name;
+        if (auto separator = wide.rfind(L'\\'); separator != std::wstring::npos)
+            wide.erase(0, separator + 1);
+        std::string narrow = "/";
+        for (wchar_t c : wide)
+            narrow += c < 0x80 && c != L'/' ? static_cast<char>(c) : '_';
+        return narrow;
+    }
+
+    // GetCurrentProcess() and GetCurrentThread() pseudo handles, never freed.
+    inline bool IsPseudoHandle(HANDLE handle)
+    {
+        return handle == reinterpret_cast<HANDLE>(-1) || handle == reinterpret_cast<HANDLE>(-2);
+    }
+
+    inline int ToPosix(DWORD protect)
+    {
+        switch (protect & 0xFF) {
+        case PAGE_READONLY: return PROT_READ;
+        case PAGE_READWRITE: case PAGE_WRITECOPY: return PROT_READ | PROT_WRITE;
+        case PAGE_EXECUTE: return PROT_EXEC;
+        case PAGE_EXECUTE_READ: return PROT_READ | PROT_EXEC;
+        case PAGE_EXECUTE_READWRITE: case PAGE_EXECUTE_WRITECOPY: return PROT_READ | PROT_WRITE | PROT_EXEC;
+        default: return PROT_NONE;
+        }
+    }
+
+    inline DWORD FromPosix(bool bRead, bool bWrite, bool bExecute)
+    {
+        if (bExecute)
+            return bWrite ? PAGE_EXECUTE_READWRITE : bRead ? PAGE_EXECUTE_READ : PAGE_EXECUTE;
+        if (bWrite)
+            return PAGE_READWRITE;
+        return bRead ? PAGE_READONLY : PAGE_NOACCESS;
+    }
+
+    inline std::uintptr_t PageSize()
+    {
+        static const std::uintptr_t pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+        return pageSize;
+    }
+
+    inline constexpr std::uintptr_t MaxAddress = std::uintptr_t(1) << 47;
+}
+
+inline void GetSystemInfo(SYSTEM_INFO* systemInfo)
+{
+    *systemInfo = {};
+    systemInfo->dwPageSize = static_cast<DWORD>(Platform::PageSize());
+    systemInfo->dwAllocationGranularity = static_cast<DWORD>(Platform::PageSize());
+    systemInfo->lpMinimumApplicationAddress = reinterpret_cast<LPVOID>(0x10000);
+    systemInfo->lpMaximumApplicationAddress = reinterpret_cast<LPVOID>(Platform::MaxAddress - 1);
+    systemInfo->dwNumberOfProcessors = std::thread::hardware_concurrency();
+}
+
+// From /proc/self/maps. A mapped region runs from the page of "address" to the end of the run of mappings with the
+// same protection, a free one up to the next mapping.
+inline SIZE_T VirtualQuery(LPCVOID address, MEMORY_BASIC_INFORMATION* buffer, SIZE_T length)
+{
+    if (length < sizeof(MEMORY_BASIC_INFORMATION))
+        return 0;
+
+    auto page = reinterpret_cast<std::uintptr_t>(address) & ~(Platform::PageSize() - 1);
+    if (page >= Platform::MaxAddress)
+        return 0;
+
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    bool bFound = false;
+    std::uintptr_t regionBegin = 0, regionEnd = 0, nextMapping = Platform::MaxAddress;
+    DWORD protect = PAGE_NOACCESS;
+
+    while (std::getline(maps, line)) {
+        std::uintptr_t begin = 0, end = 0;
+        char perms[5] = {};
+        if (std::sscanf(line.c_str(), "%zx-%zx %4s", &begin, &end, perms) != 3)
+            continue;
+        DWORD mappingProtect = Platform::FromPosix(perms[0] == 'r', perms[1] == 'w', perms[2] == 'x');
+
+        if (!bFound) {
+            if (end <= page)
+                continue;
+            if (begin > page) {
+                nextMapping = begin;
+                break;
+            }
+            bFound = true;
+            regionBegin = begin;
+            regionEnd = end;
+            protect = mappingProtect;
+        }
+        else if (begin == regionEnd && mappingProtect == protect) {
+            regionEnd = end;
+        }
+        else {
+            break;
+        }
+    }
+
+    *buffer = {};
+    buffer->BaseAddress = reinterpret_cast<LPVOID>(page);
+    if (bFound) {
+        buffer->AllocationBase = reinterpret_cast<LPVOID>(regionBegin);
+        buffer->AllocationProtect = protect;
+        buffer->RegionSize = regionEnd - page;
+        buffer->State = MEM_COMMIT;
+        buffer->Protect = protect;
+    }
+    else {
+        buffer->RegionSize = nextMapping - page;
+        buffer->State = MEM_FREE;
+        buffer->Protect = PAGE_NOACCESS;
+    }
+    return sizeof(MEMORY_BASIC_INFORMATION);
+}
+
+inline SIZE_T VirtualQueryEx(HANDLE, LPCVOID address, MEMORY_BASIC_INFORMATION* buffer, SIZE_T length)
+{
+    return VirtualQuery(address, buffer, length);
+}
+
+inline BOOL VirtualProtect(LPVOID address, SIZE_T size, DWORD newProtect, DWORD* oldProtect)
+{
+    MEMORY_BASIC_INFORMATION mbi{};
+    if (!VirtualQuery(address, &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT)
+        return FALSE;
+
+    auto begin = reinterpret_cast<std::uintptr_t>(address) & ~(Platform::PageSize() - 1);
+    auto end = (reinterpret_cast<std::uintptr_t>(address) + size + Platform::PageSize() - 1) & ~(Platform::PageSize() - 1);
+    if (mprotect(reinterpret_cast<void*>(begin), end - begin, Platform::ToPosix(newProtect)) != 0)
+        return FALSE;
+
+    if (oldProtect)
+        *oldProtect = mbi.Protect;
+    return TRUE;
+}
+
+inline BOOL FlushInstructionCache(HANDLE, LPCVOID address, SIZE_T size)
+{
+    auto begin = static_cast<char*>(const_cast<void*>(address));
+    __builtin___clear_cache(begin, begin + size);
+    return TRUE;
+}
+
+inline HANDLE GetCurrentProcess() { return reinterpret_cast<HANDLE>(-1); }
+inline DWORD GetCurrentProcessId() { return static_cast<DWORD>(getpid()); }
+inline HANDLE GetCurrentThread() { return reinterpret_cast<HANDLE>(-2); }
+
+inline HMODULE GetModuleHandle(const char* moduleName)
+{
+    return moduleName ? nullptr : Platform::MainModule;
+}
+
+inline DWORD GetModuleFileNameW(HMODULE module, WCHAR* filename, DWORD size)
+{
+    if (!size)
+        return 0;
+
+    std::wstring path;
+    {
+        auto& registry = Platform::Instance();
+        std::scoped_lock lock{ registry.mutex };
+        if (auto it = registry.modulePaths.find(module ? module : Platform::MainModule); it != registry.modulePaths.end())
+            path = it->second.wstring();
+    }
+
+    DWORD length = static_cast<DWORD>((std::min<std::size_t>)(path.size(), size - 1));
+    std::wmemcpy(filename, path.c_str(), length);
+    filename[length] = L'\0';
+    return length;
+}
+
+inline BOOL EnumDisplaySettings(const char*, DWORD, DEVMODE* devMode)
+{
+    if (!Platform::DesktopWidth || !Platform::DesktopHeight)
+        return FALSE;
+    devMode->dmPelsWidth = Platform::DesktopWidth;
+    devMode->dmPelsHeight = Platform::DesktopHeight;
+    return TRUE;
+}
+
+inline HANDLE CreateThread(LPSECURITY_ATTRIBUTES, SIZE_T, LPTHREAD_START_ROUTINE start, LPVOID parameter, DWORD flags, DWORD* threadId)
+{
+    auto thread = new Platform::Thread();
+    thread->start = start;
+    thread->parameter = parameter;
+    if (threadId)
+        *threadId = 0;
+    if (!(flags & CREATE_SUSPENDED))
+        thread->Start();
+    return thread;
+}
+
+inline DWORD ResumeThread(HANDLE handle)
+{
+    auto thread = static_cast<Platform::Thread*>(handle);
+    if (thread->bStarted)
+        return 0;
+    thread->Start();
+    return 1;
+}
+
+// Priorities aren't changed, the harness measures with the scheduler's defaults.
+inline BOOL SetThreadPriority(HANDLE, int) { return TRUE; }
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+    if (!handle || Platform::IsPseudoHandle(handle))
+        return FALSE;
+    delete static_cast<Platform::Object*>(handle);
+    return TRUE;
+}
+
+inline DWORD GetLastError() { return Platform::LastError; }
+
+// Shared memory only, there is no file backed mapping.
+inline HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES, DWORD protect, DWORD maximumSizeHigh, DWORD maximumSizeLow, LPCWSTR name)
+{
+    std::uint64_t size = (std::uint64_t(maximumSizeHigh) << 32) | maximumSizeLow;
+    if (file != INVALID_HANDLE_VALUE || !name || !size) {
+        Platform::LastError = ERROR_INVALID_PARAMETER;
+        return nullptr;
+    }
+
+    auto mapping = new Platform::FileMapping();
+    mapping->name = Platform::SharedMemoryName(name);
+    mapping->bCreated = true;
+    int access = (Platform::ToPosix(protect) & PROT_WRITE) ? O_RDWR : O_RDONLY;
+    bool bExisted = false;
+    mapping->fd = shm_open(mapping->name.c_str(), access | O_CREAT | O_EXCL, 0600);
+    if (mapping->fd < 0 && errno == EEXIST) {
+        bExisted = true;
+        mapping->fd = shm_open(mapping->name.c_str(), access, 0600);
+    }
+
+    // An existing object keeps its size unless it is too small
+    struct stat status{};
+    if (mapping->fd < 0 || fstat(mapping->fd, &status) != 0 || (std::uint64_t(status.st_size) < size && ftruncate(mapping->fd, static_cast<off_t>(size)) != 0)) {
+        mapping->bCreated = !bExisted && mapping->fd >= 0;
+        delete mapping;
+        Platform::LastError = ERROR_INVALID_PARAMETER;
+        return nullptr;
+    }
+    Platform::LastError = bExisted ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS;
+    return mapping;
+}
+
+inline HANDLE OpenFileMappingW(DWORD desiredAccess, BOOL, LPCWSTR name)
+{
+    auto mapping = new Platform::FileMapping();
+    mapping->name = Platform::SharedMemoryName(name);
+    mapping->fd = shm_open(mapping->name.c_str(), (desiredAccess & FILE_MAP_WRITE) ? O_RDWR : O_RDONLY, 0);
+    if (mapping->fd < 0) {
+        delete mapping;
+        Platform::LastError = ERROR_FILE_NOT_FOUND;
+        return nullptr;
+    }
+    Platform::LastError = ERROR_SUCCESS;
+    return mapping;
+}
+
+inline LPVOID MapViewOfFile(HANDLE handle, DWORD desiredAccess, DWORD offsetHigh, DWORD offsetLow, SIZE_T bytes)
+{
+    auto mapping = static_cast<Platform::FileMapping*>(handle);
+    off_t offset = static_cast<off_t>((std::uint64_t(offsetHigh) << 32) | offsetLow);
+    struct stat status{};
+    if (!bytes) {
+        if (fstat(mapping->fd, &status) != 0 || status.st_size <= offset)
+            return nullptr;
+        bytes = static_cast<SIZE_T>(status.st_size - offset);
+    }
+
+    int protect = (desiredAccess & FILE_MAP_WRITE) ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* view = mmap(nullptr, bytes, protect, MAP_SHARED, mapping->fd, offset);
+    if (view == MAP_FAILED) {
+        Platform::LastError = ERROR_INVALID_PARAMETER;
+        return nullptr;
+    }
+
+    auto& registry = Platform::Instance();
+    std::scoped_lock lock{ registry.mutex };
+    registry.views[view] = bytes;
+    return view;
+}
+
+inline BOOL UnmapViewOfFile(LPCVOID view)
+{
+    SIZE_T bytes = 0;
+    {
+        auto& registry = Platform::Instance();
+        std::scoped_lock lock{ registry.mutex };
+        auto it = registry.views.find(view);
+        if (it == registry.views.end())
+            return FALSE;
+        bytes = it->second;
+        registry.views.erase(it);
+    }
+    return munmap(const_cast<void*>(view), bytes) == 0;
+}
+
+inline void Sleep(DWORD milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+// UTF-8 only, wchar_t is UTF-32 here.
+inline int MultiByteToWideChar(UINT, DWORD, const char* multiByte, int multiByteSize, WCHAR* wide, int wideSize)
+{
+    auto bytes = reinterpret_cast<const unsigned char*>(multiByte);
+    std::size_t size = multiByteSize < 0 ? std::strlen(multiByte) + 1 : static_cast<std::size_t>(multiByteSize);
+    int count = 0;
+
+    for (std::size_t i = 0; i < size;) {
+        unsigned char lead = bytes[i];
+        int length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 1;
+        char32_t codePoint = length == 1 ? (lead < 0x80 ? lead : 0xFFFD) : lead & (0x7F >> length);
+        for (int n = 1; n < length; ++n)
+            codePoint = i + n < size ? (codePoint << 6) | (bytes[i + n] & 0x3F) : 0xFFFD;
+        i += length;
+
+        if (wideSize) {
+            if (count == wideSize)
+                return 0;
+            wide[count] = static_cast<WCHAR>(codePoint);
+        }
+        ++count;
+    }
+    return count;
+}
+
+inline int wcstombs_s(std::size_t* converted, char* multiByte, std::size_t multiByteSize, const wchar_t* wide, std::size_t count)
+{
+    std::size_t length = std::wcstombs(multiByte, wide, (std::min)(count, multiByteSize - 1));
+    if (length == static_cast<std::size_t>(-1))
+        length = 0;
+    multiByte[length] = '\0';
+    if (converted)
+        *converted = length + 1;
+    return 0;
+}
+
+// There is no console to allocate; stdout already goes to the terminal.
+inline BOOL AllocConsole() { return TRUE; }
+
+inline int freopen_s(std::FILE** file, const char* path, const char* mode, std::FILE* stream)
+{
+    if (std::strcmp(path, "CONOUT$") == 0) {
+        *file = stream;
+        return 0;
+    }
+    *file = std::freopen(path, mode, stream);
+    return *file ? 0 : 1;
+}
+
+// The fix gave up. A DLL would unload itself and leave the game running; the harness process ends.
+[[noreturn]] inline void FreeLibraryAndExitThread(HMODULE, DWORD exitCode)
+{
+    std::fflush(stdout);
+    std::_Exit(static_cast<int>(exitCode));
+}
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// Per-resolution values read by the per-frame hooks. The resolution hook builds a new snapshot whenever the
+// resolution changes and publishes it under a sequence counter, so readers never see a half-updated set.
+namespace Render
+{
+    // One cache line, copied in and out of the snapshot whole.
+    struct alignas(64) Params
+    {
+        float fAspectRatio = 0.00f;
+        float fAspectMultiplier = 1.00f;
+
+        // Scales tan(fov / 2) to correct vert- FOV, 1 at or below the native aspect ratio
+        float fFOVScale = 1.00f;
+
+        // HUD canvas, already rounded up the way the HUD hook passes them to the game
+        bool bPillarbox = false;
+        bool bLetterbox = false;
+        int iHUDWidth = 0;
+        int iHUDHeight = 0;
+        int iHUDWidthOffset = 0;
+        int iHUDHeightOffset = 0;
+
+        // Set by Publish(), tells snapshots apart
+        std::uint32_t iGeneration = 0;
+    };
+    static_assert(sizeof(Params) == 64);
+
+    // Same scheme as Telemetry's screenSequence: the sequence is odd while the snapshot is being written, and a reader
+    // that saw it change tries again. The words are atomics, so a reader racing a publish gets a retry rather than a
+    // data race.
+    class Snapshot
+    {
+    public:
+        Snapshot()
+        {
+            Publish(Params{});
+        }
+
+        // One publisher at a time. Neither locks nor allocates.
+        void Publish(const Params& params)
+        {
+            Params published = params;
+            published.iGeneration = ++m_generation;
+            auto words = std::bit_cast<std::array<std::uint32_t, Words>>(published);
+
+            auto sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (std::size_t i = 0; i < Words; ++i)
+                m_words[i].store(words[i], std::memory_order_relaxed);
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // A copy, so it stays consistent however long the caller keeps it. Resolution changes come seconds apart, so
+        // the loop practically never runs twice.
+        Params Get() const
+        {
+            std::array<std::uint32_t, Words> words;
+            std::uint32_t before = 0, after = 0;
+            do {
+                before = m_sequence.load(std::memory_order_acquire);
+                for (std::size_t i = 0; i < Words; ++i)
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_sequence.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+
+            return std::bit_cast<Params>(words);
+        }
+
+    private:
+        static constexpr std::size_t Words = sizeof(Params) / sizeof(std::uint32_t);
+
+        alignas(64) std::atomic<std::uint32_t> m_sequence{ 0 };
+        alignas(64) std::array<std::atomic<std::uint32_t>, Words> m_words{};
+        std::uint32_t m_generation = 0;
+    };
+
+    // Degrees in, degrees out. Only recomputed when the game's base FOV or the snapshot changes.
+    inline float CorrectFOV(const Params& params, float fFOV)
+    {
+        constexpr float fPi = 3.1415926535f;
+
+        struct Memo
+        {
+            std::uint32_t iGeneration = UINT32_MAX;
+            float fIn = 0.00f;
+            float fOut = 0.00f;
+        };
+        thread_local Memo memo;
+
+        if (memo.iGeneration != params.iGeneration || memo.fIn != fFOV)
+            memo = { params.iGeneration, fFOV, atanf(tanf(fFOV * (fPi / 360)) * params.fFOVScale) * (360 / fPi) };
+        return memo.fOut;
+    }
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "scanner.hpp"
+
+// Background rescanning for signatures that weren't found at startup, e.g. because the code they match is unpacked
+// or committed after the DLL loads.
+//
+// A pass never reads the whole module. It compares the module's committed blocks (runs of pages with one protection,
+// as VirtualQuery reports them) against the previous pass and only hashes and scans blocks that appeared or changed
+// size or protection. Code written in place without a protection change is caught by hashing a fixed budget of the
+// remaining pages per pass, round robin. Changed parts are widened by a signature length so a match straddling a
+// changed and an unchanged page is still found. The first pass has nothing to compare against and scans everything
+// once. A hit in a partial scan is checked against the whole scope before it is accepted, so it is the first match
+// and carries the same match count the startup scan would have reported. Passes that see no change back off, up to
+// a maximum interval, until a deadline after which the rescanner gives up.
+namespace Rescan
+{
+    inline std::uint64_t HashPage(const std::uint8_t* data, std::size_t size)
+    {
+        constexpr std::uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+        constexpr std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+
+        // Four independent lanes keep the loop bound by memory rather than by multiply latency
+        std::uint64_t lanes[4] = { Prime1, Prime2, 0, ~Prime1 };
+        std::size_t position = 0;
+        for (; position + 32 <= size; position += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                std::uint64_t word;
+                std::memcpy(&word, data + position + 8 * lane, sizeof(word));
+                lanes[lane] = std::rotl(lanes[lane] + word * Prime2, 31) * Prime1;
+            }
+        }
+
+        std::uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+        for (; position < size; ++position)
+            hash = (hash ^ data[position]) * Prime1;
+        return hash ^ (hash >> 29);
+    }
+
+    // Committed, readable pages of the module with a single protection, in address order.
+    struct Block
+    {
+        std::size_t offset = 0;
+        std::size_t size = 0;
+        std::uint32_t protect = 0;
+
+        bool operator==(const Block&) const = default;
+    };
+
+    // The regions a scope is scanned in: adjacent blocks merged, so matches spanning a protection change are found.
+    inline std::vector<Scanner::Region> Merge(const std::vector<Block>& blocks)
+    {
+        std::vector<Scanner::Region> regions;
+        for (const auto& block : blocks) {
+            if (!regions.empty() && regions.back().offset + regions.back().size == block.offset)
+                regions.back().size += block.size;
+            else
+                regions.push_back({ block.offset, block.size });
+        }
+        return regions;
+    }
+
+    // Tracks one scope of the module between passes.
+    class PageTracker
+    {
+    public:
+        PageTracker(std::size_t pageSize, std::size_t sampleBytes) : m_pageSize(pageSize), m_samplePages((std::max<std::size_t>)(sampleBytes / pageSize, 1)) {}
+
+        // Parts of "blocks" that are new or changed since the previous call, each widened by "overlap" bytes on both
+        // sides within its merged region.
+        std::vector<Scanner::Region> Changed(const std::uint8_t* base, const std::vector<Block>& blocks, std::size_t overlap)
+        {
+            std::vector<Scanner::Region> changed;
+            std::unordered_map<std::size_t, std::uint64_t> hashes;
+            std::vector<Scanner::Region> known;    // Pages of unchanged blocks, clipped to their block
+            hashes.reserve(m_hashes.size());
+            m_hashedBytes = 0;
+
+            for (const auto& block : blocks) {
+                bool bKnown = std::binary_search(m_blocks.begin(), m_blocks.end(), block, [](const Block& a, const Block& b) {
+                    return a.offset != b.offset ? a.offset < b.offset : a.size != b.size ? a.size < b.size : a.protect < b.protect;
+                    });
+
+                std::size_t blockEnd = block.offset + block.size;
+                for (std::size_t page = block.offset & ~(m_pageSize - 1); page < blockEnd; page += m_pageSize) {
+                    std::size_t begin = (std::max)(page, block.offset);
+                    std::size_t end = (std::min)(page + m_pageSize, blockEnd);
+                    auto previous = m_hashes.find(page);
+                    if (bKnown && previous != m_hashes.end()) {
+                        hashes[page] = previous->second;
+                        known.push_back({ begin, end - begin });
+                        continue;
+                    }
+
+                    // New or remapped, take its hashes now so later samples have something to compare against
+                    hashes[page] = HashPage(base + begin, end - begin);
+                    m_hashedBytes += end - begin;
+                }
+                if (!bKnown)
+                    changed.push_back({ block.offset, block.size });
+            }
+
+            // Pages are sampled in address order, continuing where the previous pass stopped
+            if (!known.empty()) {
+                auto next = std::lower_bound(known.begin(), known.end(), m_cursor, [](const Scanner::Region& page, std::size_t offset) { return page.offset < offset; });
+                std::size_t first = next - known.begin();
+                std::size_t samples = (std::min)(m_samplePages, known.size());
+                for (std::size_t i = 0; i < samples; ++i) {
+                    const auto& page = known[(first + i) % known.size()];
+                    std::uint64_t hash = HashPage(base + page.offset, page.size);
+                    m_hashedBytes += page.size;
+                    auto& stored = hashes[page.offset & ~(m_pageSize - 1)];
+                    if (stored != hash) {
+                        stored = hash;
+                        changed.push_back(page);
+                    }
+                }
+                m_cursor = known[(first + samples) % known.size()].offset;
+            }
+
+            m_blocks = blocks;
+            m_hashes = std::move(hashes);
+            return Widen(std::move(changed), Merge(blocks), overlap);
+        }
+
+        std::size_t Pages() const { return m_hashes.size(); }
+
+        // Bytes the last call read to hash
+        std::size_t HashedBytes() const { return m_hashedBytes; }
+
+    private:
+        static std::vector<Scanner::Region> Widen(std::vector<Scanner::Region> changed, const std::vector<Scanner::Region>& regions, std::size_t overlap)
+        {
+            std::sort(changed.begin(), changed.end(), [](const Scanner::Region& a, const Scanner::Region& b) { return a.offset < b.offset; });
+
+            std::vector<Scanner::Region> widened;
+            auto region = regions.begin();
+            for (const auto& part : changed) {
+                while (region != regions.end() && region->offset + region->size <= part.offset)
+                    ++region;
+                if (region == regions.end())
+                    break;
+
+                std::size_t begin = part.offset - region->offset > overlap ? part.offset - overlap : region->offset;
+                std::size_t end = (std::min)(part.offset + part.size + overlap, region->offset + region->size);
+                if (!widened.empty() && widened.back().offset + widened.back().size >= begin)
+                    widened.back().size = (std::max)(widened.back().offset + widened.back().size, end) - widened.back().offset;
+                else
+                    widened.push_back({ begin, end - begin });
+            }
+            return widened;
+        }
+
+        std::size_t m_pageSize;
+        std::size_t m_samplePages;
+        std::vector<Block> m_blocks;
+        std::unordered_map<std::size_t, std::uint64_t> m_hashes;   // Page offset to hash
+        std::size_t m_cursor = 0;                                   // Offset the next sample starts at
+        std::size_t m_hashedBytes = 0;
+    };
+
+    // Entries no scan has found yet.
+    inline std::size_t Missing(const Scanner::MultiScanner& scans)
+    {
+        return static_cast<std::size_t>(std::count_if(scans.Entries().begin(), scans.Entries().end(), [](const auto& entry) { return !entry.result.address; }));
+    }
+
+    struct Options
+    {
+        std::chrono::milliseconds interval{ 250 };      // After a pass that saw changes
+        std::chrono::milliseconds maxInterval{ 8000 };  // Backoff limit while nothing changes
+        std::chrono::milliseconds deadline{ 120000 };   // Since Start()
+        std::size_t sampleBytes = 1024 * 1024;          // Of unchanged blocks, hashed per pass and scope
+        unsigned threads = 0;                           // Each pass scans on at most this many, 0 for Scanner::MaxThreads
+    };
+
+    struct Pass
+    {
+        std::size_t changedBytes = 0;
+        std::size_t hashedBytes = 0;
+        std::vector<std::size_t> resolved;              // Ids newly found in this pass
+    };
+
+    // Scans for the unresolved entries of a MultiScanner. Not thread safe, one thread owns it and the scanner.
+    class Rescanner
+    {
+    public:
+        // Committed blocks of the module for a scope, queried again every pass.
+        using BlocksFn = std::function<std::vector<Block>(Scanner::Scope)>;
+
+        Rescanner(const std::uint8_t* base, std::size_t pageSize, BlocksFn blocks, Options options = {})
+            : m_base(base), m_blocks(std::move(blocks)), m_options(options), m_executable(pageSize, options.sampleBytes), m_image(pageSize, options.sampleBytes)
+        {
+            m_interval = m_options.interval;
+        }
+
+        void Start() { m_start = std::chrono::steady_clock::now(); }
+
+        bool Expired() const { return std::chrono::steady_clock::now() - m_start >= m_options.deadline; }
+
+        // How long to wait before the next pass.
+        std::chrono::milliseconds Interval() const { return m_interval; }
+
+        Pass Run(Scanner::MultiScanner& scans)
+        {
+            Pass pass;
+            std::size_t overlap = 0;
+            bool bScope[2] = {};
+            for (std::size_t id = 0; id < scans.Entries().size(); ++id) {
+                const auto& entry = scans.Entries()[id];
+                if (entry.resolved)
+                    continue;
+
+                // Found by an earlier scan, keep it out of this one
+                if (entry.result.address) {
+                    scans.Resolve(id, entry.result);
+                    continue;
+                }
+                overlap = (std::max)(overlap, entry.pattern.size - 1);
+                bScope[entry.scope == Scanner::Scope::Image] = true;
+            }
+
+            // Only the scopes that still have something to find are looked at
+            std::vector<Block> executableBlocks, imageBlocks;
+            std::vector<Scanner::Region> executable, image;
+            if (bScope[0]) {
+                executableBlocks = m_blocks(Scanner::Scope::Executable);
+                executable = m_executable.Changed(m_base, executableBlocks, overlap);
+                pass.hashedBytes += m_executable.HashedBytes();
+            }
+            if (bScope[1]) {
+                imageBlocks = m_blocks(Scanner::Scope::Image);
+                image = m_image.Changed(m_base, imageBlocks, overlap);
+                pass.hashedBytes += m_image.HashedBytes();
+            }
+            for (const auto& region : executable)
+                pass.changedBytes += region.size;
+            for (const auto& region : image)
+                pass.changedBytes += region.size;
+
+            // Back off while the module is settled, start over as soon as it changes
+            m_interval = pass.changedBytes ? m_options.interval : (std::min)(m_interval * 2, m_options.maxInterval);
+            if (!pass.changedBytes)
+                return pass;
+
+            scans.Scan(m_base, executable, image, m_options.threads);
+            for (std::size_t id = 0; id < scans.Entries().size(); ++id) {
+                const auto& entry = scans.Entries()[id];
+                if (entry.resolved || !entry.result.address)
+                    continue;
+
+                // This pass only saw part of the scope. Take the first match and the count from all of it, as the
+                // startup scan would have.
+                auto regions = Merge(entry.scope == Scanner::Scope::Image ? imageBlocks : executableBlocks);
+                Scanner::MultiScanner full;
+                full.Add(entry.name, entry.pattern, entry.scope);
+                full.Scan(m_base, regions, regions, m_options.threads);
+                if (!full[0].address) {
+                    // Not a match after all, or gone again. Forget it so it's scanned for again rather than taken as
+                    // found by the next pass.
+                    scans.Clear(id);
+                    continue;
+                }
+                scans.Resolve(id, full[0]);
+                pass.resolved.push_back(id);
+            }
+            return pass;
+        }
+
+    private:
+        const std::uint8_t* m_base;
+        BlocksFn m_blocks;
+        Options m_options;
+        PageTracker m_executable;
+        PageTracker m_image;
+        std::chrono::milliseconds m_interval;
+        std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+    };
+}
@@ -0,0 +1,1028 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SCANNER_X86 0
+#endif
+
+// MSVC lets us use AVX2 intrinsics without /arch:AVX2, GCC/Clang need the function tagged.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SCANNER_TARGET_AVX2
+#else
+#define SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Signature scanning over plain byte buffers. Nothing in here touches the Windows API so it can be used against
+// a mapped image, a file on disk or a synthetic buffer.
+namespace Scanner
+{
+    // Packed signature. One value byte and one mask byte per position (0xFF = must match, 0x00 = wildcard).
+    // Wildcard positions hold 0 in "bytes" so a block can be checked with a single and/compare.
+    // "anchor" and "anchor2" are the offsets of the two rarest non-wildcard bytes, used to find candidates.
+    struct PatternView
+    {
+        const std::uint8_t* bytes = nullptr;
+        const std::uint8_t* mask = nullptr;
+        std::size_t size = 0;
+        std::size_t anchor = 0;
+        std::size_t anchor2 = 0;
+        bool wildcardOnly = true;
+    };
+
+    // Rough byte frequency in x64 code, most common first. Anything not listed is treated as rare.
+    inline constexpr std::uint8_t CommonBytes[] = {
+        0x00, 0xFF, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0x44, 0x4C, 0xE8, 0x8D, 0x01, 0xCC, 0x83, 0x85, 0x10,
+        0x08, 0x20, 0x40, 0xC0, 0x74, 0x45, 0x41, 0x4D, 0x49, 0x18, 0x28, 0x30, 0x38, 0xC3, 0x90, 0x84,
+        0x75, 0x33, 0xF3, 0x50, 0xEB, 0x66, 0x05, 0x04, 0x02, 0xC7, 0x8A, 0x80, 0x3B, 0x39, 0x5C, 0xC5,
+    };
+
+    constexpr int ByteFrequency(std::uint8_t value)
+    {
+        constexpr int count = static_cast<int>(sizeof(CommonBytes));
+        for (int i = 0; i < count; ++i) {
+            if (CommonBytes[i] == value)
+                return count - i;
+        }
+        return 0;
+    }
+
+    // Pick the two rarest non-wildcard bytes. Ties go to the earliest offset.
+    constexpr void SelectAnchors(const std::uint8_t* bytes, const std::uint8_t* mask, std::size_t size, std::size_t& anchor, std::size_t& anchor2, bool& wildcardOnly)
+    {
+        anchor = anchor2 = 0;
+        wildcardOnly = true;
+        int best = 0x7FFFFFFF;
+        int second = 0x7FFFFFFF;
+
+        for (std::size_t i = 0; i < size; ++i) {
+            if (!mask[i])
+                continue;
+
+            int frequency = ByteFrequency(bytes[i]);
+            if (wildcardOnly) {
+                wildcardOnly = false;
+                anchor = anchor2 = i;
+                best = frequency;
+            }
+            else if (frequency < best) {
+                anchor2 = anchor;
+                second = best;
+                anchor = i;
+                best = frequency;
+            }
+            else if (frequency < second || anchor2 == anchor) {
+                anchor2 = i;
+                second = frequency;
+            }
+        }
+    }
+
+    // Runtime-parsed signature, e.g. "48 8B ?? ?? E8". Owns its storage.
+    struct Pattern
+    {
+        std::vector<std::uint8_t> bytes;
+        std::vector<std::uint8_t> mask;
+        std::size_t anchor = 0;
+        std::size_t anchor2 = 0;
+        bool wildcardOnly = true;
+
+        PatternView View() const
+        {
+            return { bytes.data(), mask.data(), bytes.size(), anchor, anchor2, wildcardOnly };
+        }
+    };
+
+    inline Pattern Parse(const char* signature)
+    {
+        Pattern pattern;
+
+        for (auto current = signature; *current;) {
+            if (*current == ' ') {
+                ++current;
+                continue;
+            }
+
+            if (*current == '?') {
+                ++current;
+                if (*current == '?')
+                    ++current;
+                pattern.bytes.push_back(0x00);
+                pattern.mask.push_back(0x00);
+            }
+            else {
+                char* end = nullptr;
+                pattern.bytes.push_back(static_cast<std::uint8_t>(std::strtoul(current, &end, 16)));
+                pattern.mask.push_back(0xFF);
+                current = (end == current) ? current + 1 : end;
+            }
+        }
+
+        SelectAnchors(pattern.bytes.data(), pattern.mask.data(), pattern.bytes.size(), pattern.anchor, pattern.anchor2, pattern.wildcardOnly);
+        return pattern;
+    }
+
+    // Compile-time signatures. Sig<"48 8B ?? ?? E8"> is parsed and packed during compilation, a malformed signature
+    // fails the build and scanning with it neither parses nor allocates.
+    template<std::size_t N>
+    struct FixedString
+    {
+        char value[N]{};
+
+        consteval FixedString(const char (&str)[N])
+        {
+            std::copy_n(str, N, value);
+        }
+    };
+
+    namespace Detail
+    {
+        consteval bool IsHexDigit(char c)
+        {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        }
+
+        consteval std::uint8_t HexValue(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return static_cast<std::uint8_t>(c - '0');
+            if (c >= 'a' && c <= 'f')
+                return static_cast<std::uint8_t>(c - 'a' + 10);
+            return static_cast<std::uint8_t>(c - 'A' + 10);
+        }
+
+        // Calls "visit(value, isWildcard)" for each token. Throwing here is what turns a bad signature into a
+        // compile error, as a throw can't be constant evaluated.
+        template<typename Visitor>
+        consteval std::size_t Tokenize(const char* signature, Visitor visit)
+        {
+            std::size_t count = 0;
+
+            for (std::size_t i = 0; signature[i];) {
+                if (signature[i] == ' ') {
+                    ++i;
+                    continue;
+                }
+
+                std::size_t start = i;
+                while (signature[i] && signature[i] != ' ')
+                    ++i;
+                std::size_t length = i - start;
+
+                if (signature[start] == '?') {
+                    if (length > 2 || (length == 2 && signature[start + 1] != '?'))
+                        throw "Signature: wildcards must be written as ? or ??";
+                    visit(static_cast<std::uint8_t>(0x00), true);
+                }
+                else {
+                    if (length != 2 || !IsHexDigit(signature[start]) || !IsHexDigit(signature[start + 1]))
+                        throw "Signature: bytes must be two hex digits";
+                    visit(static_cast<std::uint8_t>(HexValue(signature[start]) << 4 | HexValue(signature[start + 1])), false);
+                }
+                ++count;
+            }
+
+            if (count == 0)
+                throw "Signature: empty signature";
+            return count;
+        }
+
+        template<std::size_t N>
+        struct CompiledPattern
+        {
+            std::array<std::uint8_t, N> bytes{};
+            std::array<std::uint8_t, N> mask{};
+            std::size_t anchor = 0;
+            std::size_t anchor2 = 0;
+            bool wildcardOnly = true;
+        };
+
+        template<std::size_t N>
+        consteval CompiledPattern<N> Compile(const char* signature)
+        {
+            CompiledPattern<N> pattern{};
+            std::size_t i = 0;
+
+            Tokenize(signature, [&](std::uint8_t value, bool isWildcard) {
+                pattern.bytes[i] = isWildcard ? 0x00 : value;
+                pattern.mask[i] = isWildcard ? 0x00 : 0xFF;
+                ++i;
+                });
+
+            SelectAnchors(pattern.bytes.data(), pattern.mask.data(), N, pattern.anchor, pattern.anchor2, pattern.wildcardOnly);
+            return pattern;
+        }
+    }
+
+    template<FixedString Signature>
+    struct Sig
+    {
+        static constexpr std::size_t Size = Detail::Tokenize(Signature.value, [](std::uint8_t, bool) {});
+        static constexpr Detail::CompiledPattern<Size> Compiled = Detail::Compile<Size>(Signature.value);
+
+        static constexpr const char* String() { return Signature.value; }
+
+        constexpr operator PatternView() const
+        {
+            return { Compiled.bytes.data(), Compiled.mask.data(), Size, Compiled.anchor, Compiled.anchor2, Compiled.wildcardOnly };
+        }
+    };
+
+    inline bool Matches(const std::uint8_t* data, const PatternView& pattern)
+    {
+        std::size_t i = 0;
+
+#if SCANNER_X86
+        for (; i + 16 <= pattern.size; i += 16) {
+            __m128i block = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.mask + i)));
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.bytes + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, value)) != 0xFFFF)
+                return false;
+        }
+#endif
+
+        for (; i < pattern.size; ++i) {
+            if ((data[i] & pattern.mask[i]) != pattern.bytes[i])
+                return false;
+        }
+        return true;
+    }
+
+    using FindFn = const std::uint8_t* (*)(const std::uint8_t* data, std::size_t size, const PatternView& pattern);
+
+    // Walks the rarest byte with memchr and checks the rest of the mask at each hit.
+    inline const std::uint8_t* FindScalar(const std::uint8_t* data, std::size_t size, const PatternView& pattern)
+    {
+        if (pattern.size == 0 || size < pattern.size)
+            return nullptr;
+
+        const std::size_t last = size - pattern.size;
+        if (pattern.wildcardOnly)
+            return data;
+
+        const std::uint8_t value = pattern.bytes[pattern.anchor];
+        std::size_t i = 0;
+
+        while (i <= last) {
+            auto hit = static_cast<const std::uint8_t*>(std::memchr(data + i + pattern.anchor, value, last - i + 1));
+            if (!hit)
+                return nullptr;
+
+            i = static_cast<std::size_t>(hit - data) - pattern.anchor;
+            if (Matches(data + i, pattern))
+                return data + i;
+            ++i;
+        }
+        return nullptr;
+    }
+
+#if SCANNER_X86
+    // Compares 16 candidate positions at a time against both anchor bytes, then verifies the survivors.
+    inline const std::uint8_t* FindSSE2(const std::uint8_t* data, std::size_t size, const PatternView& pattern)
+    {
+        if (pattern.size == 0 || size < pattern.size)
+            return nullptr;
+
+        const std::size_t last = size - pattern.size;
+        if (pattern.wildcardOnly)
+            return data;
+
+        const __m128i first = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+        const __m128i second = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor2]));
+        std::size_t i = 0;
+
+        // Only take blocks where every candidate position is valid, the loads then stay inside the buffer.
+        for (; i + 16 <= last + 1; i += 16) {
+            __m128i a = _mm_cmpeq_epi8(first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + pattern.anchor)));
+            __m128i b = _mm_cmpeq_epi8(second, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + pattern.anchor2)));
+            auto candidates = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(a, b)));
+
+            while (candidates) {
+                std::size_t offset = i + std::countr_zero(candidates);
+                if (Matches(data + offset, pattern))
+                    return data + offset;
+                candidates &= candidates - 1;
+            }
+        }
+
+        for (; i <= last; ++i) {
+            if (Matches(data + i, pattern))
+                return data + i;
+        }
+        return nullptr;
+    }
+
+    SCANNER_TARGET_AVX2 inline const std::uint8_t* FindAVX2(const std::uint8_t* data, std::size_t size, const PatternView& pattern)
+    {
+        if (pattern.size == 0 || size < pattern.size)
+            return nullptr;
+
+        const std::size_t last = size - pattern.size;
+        if (pattern.wildcardOnly)
+            return data;
+
+        const __m256i first = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+        const __m256i second = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor2]));
+        std::size_t i = 0;
+
+        for (; i + 32 <= last + 1; i += 32) {
+            __m256i a = _mm256_cmpeq_epi8(first, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + pattern.anchor)));
+            __m256i b = _mm256_cmpeq_epi8(second, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + pattern.anchor2)));
+            auto candidates = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(a, b)));
+
+            while (candidates) {
+                std::size_t offset = i + std::countr_zero(candidates);
+                if (Matches(data + offset, pattern))
+                    return data + offset;
+                candidates &= candidates - 1;
+            }
+        }
+
+        // Finish the remainder 16 at a time.
+        if (auto result = FindSSE2(data + i, size - i, pattern))
+            return result;
+        return nullptr;
+    }
+#endif
+
+    enum class Isa
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    inline const char* IsaName(Isa isa)
+    {
+        switch (isa) {
+        case Isa::AVX2:
+            return "AVX2";
+        case Isa::SSE2:
+            return "SSE2";
+        default:
+            return "Scalar";
+        }
+    }
+
+    inline Isa DetectIsa()
+    {
+#if SCANNER_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4] = {};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse2 = (info[3] & (1 << 26)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && avx) {
+            __cpuidex(info, 7, 0);
+            // AVX2 also needs the OS to save YMM state (XCR0 bits 1 and 2).
+            avx2 = (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        }
+
+        if (avx2)
+            return Isa::AVX2;
+        if (sse2)
+            return Isa::SSE2;
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return Isa::SSE2;
+#endif
+#endif
+        return Isa::Scalar;
+    }
+
+    inline FindFn Kernel(Isa isa)
+    {
+#if SCANNER_X86
+        switch (isa) {
+        case Isa::AVX2:
+            return FindAVX2;
+        case Isa::SSE2:
+            return FindSSE2;
+        default:
+            break;
+        }
+#endif
+        return FindScalar;
+    }
+
+    // Kernel used by every search, the best one the CPU supports unless lowered with ForceIsa().
+    inline std::atomic<Isa> SelectedIsa = DetectIsa();
+
+    inline Isa ActiveIsa()
+    {
+        return SelectedIsa.load(std::memory_order_relaxed);
+    }
+
+    // Pins searches to a lower tier, e.g. to compare kernels. Fails if the CPU doesn't support "isa".
+    inline bool ForceIsa(Isa isa)
+    {
+        if (static_cast<int>(isa) > static_cast<int>(DetectIsa()))
+            return false;
+        SelectedIsa = isa;
+        return true;
+    }
+
+    // Lowest address in [data, data + size) where the whole pattern matches, or nullptr.
+    inline const std::uint8_t* Find(const std::uint8_t* data, std::size_t size, const PatternView& pattern)
+    {
+        return Kernel(ActiveIsa())(data, size, pattern);
+    }
+
+    inline std::vector<const std::uint8_t*> FindAll(const std::uint8_t* data, std::size_t size, const PatternView& pattern)
+    {
+        std::vector<const std::uint8_t*> matches;
+        std::size_t offset = 0;
+
+        while (offset < size) {
+            auto match = Find(data + offset, size - offset, pattern);
+            if (!match)
+                break;
+            matches.push_back(match);
+            offset = static_cast<std::size_t>(match - data) + 1;
+        }
+        return matches;
+    }
+
+    // Part of a buffer to scan, e.g. one section of a mapped image.
+    struct Region
+    {
+        std::size_t offset = 0;
+        std::size_t size = 0;
+    };
+
+    // Which regions a signature is searched in. Code signatures only need executable sections.
+    enum class Scope
+    {
+        Executable,
+        Image,
+    };
+
+    // Minimal PE parsing, enough to find the sections of a mapped image.
+    struct Section
+    {
+        char name[9] = {};
+        std::uint32_t virtualAddress = 0;
+        std::uint32_t virtualSize = 0;
+        std::uint32_t characteristics = 0;
+    };
+
+    inline constexpr std::uint32_t SectionCode = 0x00000020;
+    inline constexpr std::uint32_t SectionExecute = 0x20000000;
+
+    template<typename T>
+    T ReadField(const std::uint8_t* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    inline std::uint32_t ImageSize(const std::uint8_t* image)
+    {
+        auto ntHeaders = image + ReadField<std::uint32_t>(image + 0x3C);
+        // SizeOfImage sits at the same offset in the PE32 and PE32+ optional header.
+        return ReadField<std::uint32_t>(ntHeaders + 0x18 + 0x38);
+    }
+
+    // "size" is how much of "image" may be read. The loader has already validated a loaded module, an image mapped
+    // from a file by hand has to pass the size of its buffer: headers that point past it end the walk early and
+    // sections are clamped to it.
+    inline std::vector<Section> Sections(const std::uint8_t* image, std::size_t size = SIZE_MAX)
+    {
+        std::vector<Section> sections;
+        auto fits = [size](std::size_t offset, std::size_t length) { return offset <= size && size - offset >= length; };
+        if (!fits(0, 0x40) || ReadField<std::uint16_t>(image) != 0x5A4D)
+            return sections;
+
+        std::size_t ntHeaders = ReadField<std::uint32_t>(image + 0x3C);
+        if (!fits(ntHeaders, 0x18) || ReadField<std::uint32_t>(image + ntHeaders) != 0x00004550)
+            return sections;
+
+        auto numberOfSections = ReadField<std::uint16_t>(image + ntHeaders + 0x6);
+        auto sizeOfOptionalHeader = ReadField<std::uint16_t>(image + ntHeaders + 0x14);
+        std::size_t sectionHeader = ntHeaders + 0x18 + sizeOfOptionalHeader;
+
+        for (std::uint16_t i = 0; i < numberOfSections && fits(sectionHeader, 0x28); ++i, sectionHeader += 0x28) {
+            Section section;
+            std::memcpy(section.name, image + sectionHeader, 8);
+            section.virtualSize = ReadField<std::uint32_t>(image + sectionHeader + 0x8);
+            section.virtualAddress = ReadField<std::uint32_t>(image + sectionHeader + 0xC);
+            section.characteristics = ReadField<std::uint32_t>(image + sectionHeader + 0x24);
+            if (section.virtualAddress >= size)
+                continue;
+            section.virtualSize = static_cast<std::uint32_t>((std::min<std::size_t>)(section.virtualSize, size - section.virtualAddress));
+            sections.push_back(section);
+        }
+        return sections;
+    }
+
+    inline std::vector<Region> ExecutableRegions(const std::uint8_t* image, std::size_t size = SIZE_MAX)
+    {
+        std::vector<Region> regions;
+        for (const auto& section : Sections(image, size)) {
+            if (section.characteristics & (SectionCode | SectionExecute))
+                regions.push_back({ section.virtualAddress, section.virtualSize });
+        }
+        return regions;
+    }
+
+    // Upper bound on the threads a scan uses, 0 for one per core. A scan can ask for fewer of its own.
+    inline std::atomic<unsigned> MaxThreads = 0;
+
+    // Threads shared by every parallel scan, so a scan doesn't pay for creating and joining its own. They're started
+    // on first use and joined by Stop() once scanning is done; joining them while the DLL unloads isn't safe, so
+    // that has to happen earlier. A scan after Stop() starts them again. One scan uses the pool at a time, a scan that
+    // finds it busy runs on its own thread instead.
+    class Pool
+    {
+    public:
+        static Pool& Instance()
+        {
+            static Pool* pool = new Pool();   // Never destroyed, see above
+            return *pool;
+        }
+
+        // Runs "work" on the calling thread and on up to "helpers" pool threads and returns once all of them have
+        // returned. Returns false without running anything if another scan has the pool or it is being stopped.
+        bool Run(const std::function<void()>& work, std::size_t helpers)
+        {
+            {
+                std::scoped_lock lock{ m_mutex };
+                if (m_work || m_stop)
+                    return false;
+                while (m_threads.size() < helpers)
+                    m_threads.emplace_back([this] { Loop(); });
+                m_work = &work;
+                m_slots = helpers;
+            }
+            m_wake.notify_all();
+
+            work();
+
+            // Helpers that haven't woken up yet have nothing left to do
+            std::unique_lock lock{ m_mutex };
+            m_slots = 0;
+            m_done.wait(lock, [this] { return m_running == 0; });
+            m_work = nullptr;
+            m_done.notify_all();
+            return true;
+        }
+
+        // Ends and joins the pool threads. Waits for a scan that is using the pool to finish first.
+        void Stop()
+        {
+            std::vector<std::thread> threads;
+            {
+                std::unique_lock lock{ m_mutex };
+                m_done.wait(lock, [this] { return !m_work; });
+                m_stop = true;
+                threads.swap(m_threads);
+            }
+            m_wake.notify_all();
+
+            for (auto& thread : threads)
+                thread.join();
+
+            std::scoped_lock lock{ m_mutex };
+            m_stop = false;
+        }
+
+    private:
+        Pool() = default;
+
+        void Loop()
+        {
+            std::unique_lock lock{ m_mutex };
+            while (true) {
+                m_wake.wait(lock, [this] { return m_slots > 0 || m_stop; });
+                if (m_stop)
+                    return;
+                --m_slots;
+                ++m_running;
+                auto work = m_work;
+                lock.unlock();
+
+                (*work)();
+
+                lock.lock();
+                if (--m_running == 0)
+                    m_done.notify_all();
+            }
+        }
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void()>* m_work = nullptr;
+        std::size_t m_slots = 0;
+        std::size_t m_running = 0;
+        bool m_stop = false;
+        std::vector<std::thread> m_threads;
+    };
+
+    // Runs "work(index)" for every index in [0, count) on up to one thread per core, including the calling thread.
+    // "maxThreads" limits this call further, 0 for no limit of its own.
+    template<typename Work>
+    void ParallelFor(std::size_t count, Work&& work, unsigned maxThreads = 0)
+    {
+        std::atomic<std::size_t> next = 0;
+        std::function<void()> worker = [&]() {
+            for (std::size_t index = next.fetch_add(1); index < count; index = next.fetch_add(1))
+                work(index);
+            };
+
+        unsigned cores = MaxThreads ? MaxThreads.load() : std::thread::hardware_concurrency();
+        if (maxThreads)
+            cores = (std::min)(cores, maxThreads);
+        std::size_t threads = (std::min<std::size_t>)((std::max)(1u, cores), count);
+        if (threads <= 1 || !Pool::Instance().Run(worker, threads - 1))
+            worker();
+    }
+
+    // Regions are split into chunks of candidate start positions. Each chunk may read up to "readEnd", past its own
+    // end by at most the signature length, so matches straddling two chunks are still found.
+    struct Chunk
+    {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::size_t regionEnd = 0;
+    };
+
+    inline constexpr std::size_t ChunkSize = 1024 * 1024;
+
+    inline std::vector<Chunk> SplitRegions(std::vector<Region> regions, std::size_t chunkSize = ChunkSize)
+    {
+        std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.offset < b.offset; });
+
+        std::vector<Chunk> chunks;
+        for (const auto& region : regions) {
+            for (std::size_t begin = region.offset; begin < region.offset + region.size; begin += chunkSize)
+                chunks.push_back({ begin, (std::min)(begin + chunkSize, region.offset + region.size), region.offset + region.size });
+        }
+        return chunks;
+    }
+
+    // Lowest address match across all regions. Chunks are searched in parallel, chunks above the best hit so far
+    // are skipped.
+    inline const std::uint8_t* Find(const std::uint8_t* base, const std::vector<Region>& regions, const PatternView& pattern)
+    {
+        auto chunks = SplitRegions(regions);
+        std::vector<const std::uint8_t*> hits(chunks.size());
+        std::atomic<std::size_t> best = chunks.size();
+
+        ParallelFor(chunks.size(), [&](std::size_t index) {
+            if (index > best.load(std::memory_order_relaxed))
+                return;
+
+            const auto& chunk = chunks[index];
+            std::size_t readable = (std::min)(chunk.end - chunk.begin + pattern.size - 1, chunk.regionEnd - chunk.begin);
+            auto hit = Find(base + chunk.begin, readable, pattern);
+            if (!hit || hit >= base + chunk.end)
+                return;
+
+            hits[index] = hit;
+            for (auto current = best.load(); index < current && !best.compare_exchange_weak(current, index);) {}
+            });
+
+        return best < chunks.size() ? hits[best] : nullptr;
+    }
+
+    struct Result
+    {
+        const std::uint8_t* address = nullptr;
+        std::size_t count = 0;
+    };
+
+    // Finds any number of signatures in one pass. The SSE2 and AVX2 sweeps test every signature's two anchor bytes on
+    // each block while it's in L1; the scalar sweep buckets signatures by their rarest byte and only checks the hit
+    // byte's bucket. Chunks of the data are swept in parallel and the per-chunk results merged, keeping the lowest
+    // address and the total count.
+    class MultiScanner
+    {
+    public:
+        struct Entry
+        {
+            std::string name;
+            PatternView pattern;
+            Scope scope = Scope::Executable;
+            Result result;
+            bool resolved = false;
+        };
+
+        std::size_t Add(std::string name, const char* signature, Scope scope = Scope::Executable)
+        {
+            auto& pattern = m_owned.emplace_back(Parse(signature));
+            return Add(std::move(name), pattern.View(), scope);
+        }
+
+        std::size_t Add(std::string name, PatternView pattern, Scope scope = Scope::Executable)
+        {
+            m_entries.push_back({ std::move(name), pattern, scope, {} });
+            return m_entries.size() - 1;
+        }
+
+        // Marks a signature as already found, e.g. from a cached offset. Resolved signatures are skipped by Scan().
+        void Resolve(std::size_t id, const std::uint8_t* address)
+        {
+            Resolve(id, { address, 1 });
+        }
+
+        void Resolve(std::size_t id, const Result& result)
+        {
+            m_entries[id].result = result;
+            m_entries[id].resolved = true;
+        }
+
+        // Number of signatures still to be scanned for.
+        std::size_t Pending() const
+        {
+            return static_cast<std::size_t>(std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) { return !entry.resolved; }));
+        }
+
+        // Scope::Executable signatures are searched in "executable", Scope::Image ones in "image". "maxThreads" limits
+        // this scan below MaxThreads, 0 for no limit of its own.
+        void Scan(const std::uint8_t* base, const std::vector<Region>& executable, const std::vector<Region>& image, unsigned maxThreads = 0)
+        {
+            for (auto& entry : m_entries) {
+                if (!entry.resolved)
+                    entry.result = {};
+            }
+
+            ScanScope(base, executable, Scope::Executable, maxThreads);
+            ScanScope(base, image, Scope::Image, maxThreads);
+        }
+
+        void Scan(const std::uint8_t* data, std::size_t size, unsigned maxThreads = 0)
+        {
+            std::vector<Region> all = { { 0, size } };
+            Scan(data, all, all, maxThreads);
+        }
+
+        // Drops the result of a signature that isn't resolved, e.g. a hit that didn't hold up.
+        void Clear(std::size_t id)
+        {
+            if (!m_entries[id].resolved)
+                m_entries[id].result = {};
+        }
+
+        const std::vector<Entry>& Entries() const { return m_entries; }
+        const Result& operator[](std::size_t id) const { return m_entries[id].result; }
+
+        std::uint8_t* Get(std::string_view name) const
+        {
+            for (const auto& entry : m_entries) {
+                if (entry.name == name)
+                    return const_cast<std::uint8_t*>(entry.result.address);
+            }
+            return nullptr;
+        }
+
+    private:
+        struct Bucket
+        {
+            std::size_t first = 0;
+            std::size_t count = 0;
+        };
+
+        // Bucket tables for the signatures of one scope.
+        struct Table
+        {
+            std::array<Bucket, 256> buckets{};
+            std::vector<std::size_t> entries;
+            std::vector<std::uint8_t> anchors;
+            std::vector<std::size_t> wildcardOnly;
+            std::size_t maxSize = 0;
+        };
+
+        Table Build(Scope scope) const
+        {
+            Table table;
+
+            for (std::size_t value = 0; value < 256; ++value) {
+                table.buckets[value].first = table.entries.size();
+                for (std::size_t id = 0; id < m_entries.size(); ++id) {
+                    const auto& pattern = m_entries[id].pattern;
+                    if (m_entries[id].scope == scope && !m_entries[id].resolved && !pattern.wildcardOnly && pattern.bytes[pattern.anchor] == value)
+                        table.entries.push_back(id);
+                }
+                table.buckets[value].count = table.entries.size() - table.buckets[value].first;
+                if (table.buckets[value].count)
+                    table.anchors.push_back(static_cast<std::uint8_t>(value));
+            }
+
+            for (std::size_t id = 0; id < m_entries.size(); ++id) {
+                if (m_entries[id].scope != scope || m_entries[id].resolved)
+                    continue;
+                if (m_entries[id].pattern.wildcardOnly)
+                    table.wildcardOnly.push_back(id);
+                table.maxSize = (std::max)(table.maxSize, m_entries[id].pattern.size);
+            }
+            return table;
+        }
+
+        void ScanScope(const std::uint8_t* base, const std::vector<Region>& regions, Scope scope, unsigned maxThreads)
+        {
+            Table table = Build(scope);
+            if (table.anchors.empty() && table.wildcardOnly.empty())
+                return;
+
+            auto chunks = SplitRegions(regions);
+            std::vector<std::vector<Result>> chunkResults(chunks.size());
+
+            ParallelFor(chunks.size(), [&](std::size_t index) {
+                const auto& chunk = chunks[index];
+                auto& results = chunkResults[index];
+                results.resize(m_entries.size());
+
+                std::size_t readable = (std::min)(chunk.end - chunk.begin + table.maxSize - 1, chunk.regionEnd - chunk.begin);
+                Sweep(table, base + chunk.begin, readable, chunk.end - chunk.begin, results);
+                }, maxThreads);
+
+            for (std::size_t index = 0; index < chunks.size(); ++index) {
+                for (std::size_t id = 0; id < m_entries.size(); ++id) {
+                    const auto& chunk = chunkResults[index][id];
+                    auto& result = m_entries[id].result;
+                    if (chunk.count && !result.count)
+                        result.address = chunk.address;
+                    result.count += chunk.count;
+                }
+            }
+        }
+
+        // Sweep one chunk. Matches must start below "limit", anything further belongs to the next chunk.
+        void Sweep(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results) const
+        {
+            if (!table.anchors.empty()) {
+                switch (ActiveIsa()) {
+#if SCANNER_X86
+                case Isa::AVX2:
+                    SweepAVX2(table, data, size, limit, results);
+                    break;
+                case Isa::SSE2:
+                    SweepSSE2(table, data, size, limit, results);
+                    break;
+#endif
+                default:
+                    SweepScalar(table, data, size, limit, results, 0);
+                    break;
+                }
+            }
+
+            // A signature made only of wildcards matches everywhere it fits.
+            for (auto id : table.wildcardOnly) {
+                const auto& pattern = m_entries[id].pattern;
+                if (size < pattern.size)
+                    continue;
+                std::size_t count = (std::min)(size - pattern.size + 1, limit);
+                results[id] = { data, count };
+            }
+        }
+
+        // "position" holds one of the anchor bytes, check each signature anchored on it.
+        void Check(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results, std::size_t position) const
+        {
+            const auto& bucket = table.buckets[data[position]];
+            for (std::size_t i = bucket.first; i < bucket.first + bucket.count; ++i) {
+                auto id = table.entries[i];
+                const auto& pattern = m_entries[id].pattern;
+
+                if (position < pattern.anchor)
+                    continue;
+
+                std::size_t start = position - pattern.anchor;
+                if (start >= limit || start + pattern.size > size)
+                    continue;
+
+                if (Matches(data + start, pattern)) {
+                    if (!results[id].count)
+                        results[id].address = data + start;
+                    ++results[id].count;
+                }
+            }
+        }
+
+        void SweepScalar(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results, std::size_t position) const
+        {
+            for (; position < size; ++position) {
+                if (table.buckets[data[position]].count)
+                    Check(table, data, size, limit, results, position);
+            }
+        }
+
+#if SCANNER_X86
+        // "start" is a possible match of signature "id", both its anchors are in place.
+        void Candidate(const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results, std::size_t id, std::size_t start) const
+        {
+            const auto& pattern = m_entries[id].pattern;
+            if (start >= limit || start + pattern.size > size || !Matches(data + start, pattern))
+                return;
+            if (!results[id].count)
+                results[id].address = data + start;
+            ++results[id].count;
+        }
+
+        // Start positions the vector loops didn't reach, every signature checked at each one.
+        void SweepTail(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results, std::size_t position) const
+        {
+            for (; position < limit && position < size; ++position) {
+                for (auto id : table.entries)
+                    Candidate(data, size, limit, results, id, position);
+            }
+        }
+
+        // Both anchors of one signature, for the vector sweeps.
+        struct Filter
+        {
+            std::uint8_t first = 0;
+            std::uint8_t second = 0;
+            std::size_t anchor = 0;
+            std::size_t anchor2 = 0;
+            std::size_t id = 0;
+        };
+
+        std::vector<Filter> Filters(const Table& table) const
+        {
+            std::vector<Filter> filters;
+            for (auto id : table.entries) {
+                const auto& pattern = m_entries[id].pattern;
+                filters.push_back({ pattern.bytes[pattern.anchor], pattern.bytes[pattern.anchor2], pattern.anchor, pattern.anchor2, id });
+            }
+            return filters;
+        }
+
+        // The vector sweeps filter every signature on both of its anchors, as Find() does for one, over the same block
+        // of start positions before moving on. The data is only read from memory once, the per-signature loads hit L1.
+        // Blocks are only swept while every signature's anchors fit, the rest goes to SweepTail().
+        void SweepSSE2(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results) const
+        {
+            auto filters = Filters(table);
+
+            std::size_t position = 0;
+            for (; position + 15 + table.maxSize <= size && position < limit; position += 16) {
+                for (const auto& filter : filters) {
+                    __m128i a = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(filter.first)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position + filter.anchor)));
+                    __m128i b = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(filter.second)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position + filter.anchor2)));
+                    auto candidates = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(a, b)));
+                    while (candidates) {
+                        Candidate(data, size, limit, results, filter.id, position + std::countr_zero(candidates));
+                        candidates &= candidates - 1;
+                    }
+                }
+            }
+            SweepTail(table, data, size, limit, results, position);
+        }
+
+        SCANNER_TARGET_AVX2 void SweepAVX2(const Table& table, const std::uint8_t* data, std::size_t size, std::size_t limit, std::vector<Result>& results) const
+        {
+            auto filters = Filters(table);
+
+            std::size_t position = 0;
+            for (; position + 31 + table.maxSize <= size && position < limit; position += 32) {
+                for (const auto& filter : filters) {
+                    __m256i a = _mm256_cmpeq_epi8(_mm256_set1_epi8(static_cast<char>(filter.first)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position + filter.anchor)));
+                    __m256i b = _mm256_cmpeq_epi8(_mm256_set1_epi8(static_cast<char>(filter.second)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position + filter.anchor2)));
+                    auto candidates = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(a, b)));
+                    while (candidates) {
+                        Candidate(data, size, limit, results, filter.id, position + std::countr_zero(candidates));
+                        candidates &= candidates - 1;
+                    }
+                }
+            }
+            SweepTail(table, data, size, limit, results, position);
+        }
+#endif
+
+        std::deque<Pattern> m_owned;
+        std::vector<Entry> m_entries;
+    };
+}
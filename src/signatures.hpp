@@ -0,0 +1,49 @@
+#pragma once
+
+#include "scanner.hpp"
+
+// Every signature the fix scans for. Parsed at compile time, a typo in one of these fails the build.
+namespace Signature
+{
+    // Resolution scaling to 16:9, also where the current resolution is read
+    inline constexpr Scanner::Sig<"76 ?? C5 ?? ?? ?? C4 ?? ?? ?? ?? 8B ?? 41 ?? ?? ?? ?? ?? ??"> Resolution;
+
+    // "bConstrainAspectRatio" test used for cutscene letterboxing
+    inline constexpr Scanner::Sig<"F6 ?? ?? ?? ?? ?? 02 0F 84 ?? ?? ?? ?? F3 44 ?? ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ??"> CutsceneAspectRatio;
+
+    // Camera FOV
+    inline constexpr Scanner::Sig<"41 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? 48 ?? ?? ?? 49 ?? ?? E8 ?? ?? ?? ??"> FOV;
+
+    // HUD canvas size and offset
+    inline constexpr Scanner::Sig<"45 ?? ?? ?? ?? ?? ?? 45 ?? ?? ?? ?? ?? ?? 49 ?? ?? ?? ?? ?? ?? 49 ?? ?? E8 ?? ?? ?? ??"> HUD;
+
+    // WS_GameInfo::IsMoviePlaying()
+    inline constexpr Scanner::Sig<"48 ?? ?? ?? 48 ?? ?? ?? ?? ?? ?? 48 ?? ?? FF ?? ?? 83 ?? ?? 01 7E ??"> IsMoviePlaying;
+
+    // "MaxSmoothedFrameRate" framerate cap
+    inline constexpr Scanner::Sig<"C5 ?? ?? ?? C5 ?? ?? ?? C5 ?? ?? ?? 76 ?? C5 ?? ?? ?? ?? ?? ?? ?? C5 ?? ?? ?? C4 ?? ?? ?? ?? C5 ?? ?? ?? 48 8D ?? ?? ??"> FramerateCap;
+
+    // "LODDistanceFactor"
+    inline constexpr Scanner::Sig<"F3 0F ?? ?? ?? ?? ?? ?? 48 8D ?? ?? 49 ?? ?? E8 ?? ?? ?? ?? 48 ?? ?? 48 8D ?? ?? ?? ?? ?? E8 ?? ?? ?? ??"> LODDistance;
+
+    // UGameEngine::Exec
+    inline constexpr Scanner::Sig<"48 89 ?? ?? ?? 55 56 57 41 ?? 41 ?? 41 ?? 41 ?? 48 8D ?? ?? ?? ?? ?? ?? 48 81 ?? ?? ?? ?? ?? 0F 29 ?? ?? ?? ?? ?? ?? 48 8B ?? ?? ?? ?? ?? 48 33 ?? 48 89 ?? ?? ?? ?? ?? 4D ?? ?? 48 ?? ?? 4C ?? ??"> EngineExec;
+
+    struct Entry
+    {
+        const char* name;
+        Scanner::PatternView pattern;
+    };
+
+    // Every signature by name, for tools and benchmarks that run the whole set.
+    inline constexpr Entry All[] = {
+        { "Resolution", Resolution },
+        { "Cutscene Aspect Ratio", CutsceneAspectRatio },
+        { "FOV", FOV },
+        { "HUD", HUD },
+        { "IsMoviePlaying", IsMoviePlaying },
+        { "Framerate Cap", FramerateCap },
+        { "LOD Distance", LODDistance },
+        { "UGameEngine::Exec", EngineExec },
+    };
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <safetyhook.hpp>
+
+// Mid-hooks that only save the registers they need.
+//
+// safetyhook's MidHook spills every GPR and all 16 XMM registers around the callback. A slim hook's stub is generated
+// for a register set declared at compile time, and it passes a Context holding only those. Registers the callback may
+// clobber under the platform ABI are always saved as well, since the hooked code can have live values in them; what
+// is skipped are the callee-saved registers that weren't asked for, which on Windows x64 includes xmm6-xmm15.
+//
+// Unlike a MidHook there is no rsp or rip in the context. x64 only.
+namespace SlimHook
+{
+    // Register bits, GPRs in encoding order, then xmm0-xmm15.
+    enum Register : std::uint32_t
+    {
+        Rax = 1u << 0, Rcx = 1u << 1, Rdx = 1u << 2, Rbx = 1u << 3, Rbp = 1u << 5, Rsi = 1u << 6, Rdi = 1u << 7,
+        R8 = 1u << 8, R9 = 1u << 9, R10 = 1u << 10, R11 = 1u << 11, R12 = 1u << 12, R13 = 1u << 13, R14 = 1u << 14, R15 = 1u << 15,
+    };
+
+    constexpr std::uint32_t Xmm(unsigned int n) { return 1u << (16 + n); }
+
+    // Registers a called function may clobber
+#if SAFETYHOOK_OS_WINDOWS
+    inline constexpr std::uint32_t Volatile = Rax | Rcx | Rdx | R8 | R9 | R10 | R11 | Xmm(0) | Xmm(1) | Xmm(2) | Xmm(3) | Xmm(4) | Xmm(5);
+#else
+    inline constexpr std::uint32_t Volatile = Rax | Rcx | Rdx | Rsi | Rdi | R8 | R9 | R10 | R11 | 0xFFFF0000u;
+#endif
+
+    // Rbx keeps the stack pointer across the call
+    constexpr std::uint32_t SavedBy(std::uint32_t mask) { return mask | Volatile | Rbx; }
+
+    // Layout matches the stub's stack frame: XMM registers from lowest, then GPRs from lowest, then rflags.
+    template<std::uint32_t Mask>
+    struct Context
+    {
+        static constexpr std::uint32_t Saved = SavedBy(Mask);
+        static constexpr int XmmCount = std::popcount(Saved >> 16);
+        static constexpr int GprCount = std::popcount(Saved & 0xFFFFu);
+
+        safetyhook::Xmm xmm[XmmCount];
+        std::uintptr_t gpr[GprCount];
+        std::uintptr_t rflags;
+
+        template<std::uint32_t Reg>
+        std::uintptr_t& Gpr()
+        {
+            static_assert(std::popcount(Reg) == 1 && Reg <= R15 && (Mask & Reg), "Register was not declared for this hook");
+            return gpr[std::popcount(Saved & 0xFFFFu & (Reg - 1))];
+        }
+
+        template<unsigned int N>
+        safetyhook::Xmm& Xmm()
+        {
+            static_assert(N < 16 && (Mask & SlimHook::Xmm(N)), "Register was not declared for this hook");
+            return xmm[std::popcount((Saved >> 16) & ((1u << N) - 1))];
+        }
+    };
+
+    template<std::uint32_t Mask>
+    using Fn = void (*)(Context<Mask>&);
+
+    // Stub that saves "saved", calls destination with a pointer to the saved registers, restores them and jumps to
+    // the trampoline. The two 8-byte slots at the end hold the destination and the trampoline.
+    inline std::vector<std::uint8_t> BuildStub(std::uint32_t saved)
+    {
+        std::vector<std::uint8_t> code;
+        auto emit = [&](std::initializer_list<std::uint8_t> bytes) { code.insert(code.end(), bytes); };
+        auto emit32 = [&](std::uint32_t value) {
+            for (int i = 0; i < 4; ++i)
+                code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+        };
+
+        int xmmCount = std::popcount(saved >> 16);
+        std::uint32_t xmmBytes = 16 * xmmCount;
+
+#if !SAFETYHOOK_OS_WINDOWS
+        emit({ 0x48, 0x8D, 0x64, 0x24, 0x80 });                          // lea rsp, [rsp-128], step over the red zone
+#endif
+        emit({ 0x9C });                                                 // pushfq
+        for (int reg = 15; reg >= 0; --reg) {
+            if (saved & (1u << reg)) {
+                if (reg >= 8)
+                    emit({ 0x41 });
+                emit({ static_cast<std::uint8_t>(0x50 + (reg & 7)) }); // push reg
+            }
+        }
+        if (xmmBytes) {
+            emit({ 0x48, 0x81, 0xEC });                                 // sub rsp, xmmBytes
+            emit32(xmmBytes);
+        }
+        for (int n = 0, slot = 0; n < 16; ++n) {
+            if (saved & Xmm(n)) {
+                emit({ 0xF3 });
+                if (n >= 8)
+                    emit({ 0x44 });
+                emit({ 0x0F, 0x7F, static_cast<std::uint8_t>(0x84 | ((n & 7) << 3)), 0x24 });   // movdqu [rsp+disp32], xmmN
+                emit32(16 * slot++);
+            }
+        }
+
+#if SAFETYHOOK_OS_WINDOWS
+        emit({ 0x48, 0x89, 0xE1 });                                     // mov rcx, rsp
+#else
+        emit({ 0x48, 0x89, 0xE7 });                                     // mov rdi, rsp
+#endif
+        emit({ 0x48, 0x89, 0xE3 });                                     // mov rbx, rsp
+#if SAFETYHOOK_OS_WINDOWS
+        emit({ 0x48, 0x83, 0xEC, 0x20 });                               // sub rsp, 32, shadow space
+#endif
+        emit({ 0x48, 0x83, 0xE4, 0xF0 });                               // and rsp, -16
+        emit({ 0xFF, 0x15 });                                           // call [rip+destination]
+        std::size_t callDisp = code.size();
+        emit32(0);
+        emit({ 0x48, 0x89, 0xDC });                                     // mov rsp, rbx
+
+        for (int n = 0, slot = 0; n < 16; ++n) {
+            if (saved & Xmm(n)) {
+                emit({ 0xF3 });
+                if (n >= 8)
+                    emit({ 0x44 });
+                emit({ 0x0F, 0x6F, static_cast<std::uint8_t>(0x84 | ((n & 7) << 3)), 0x24 });   // movdqu xmmN, [rsp+disp32]
+                emit32(16 * slot++);
+            }
+        }
+        if (xmmBytes) {
+            emit({ 0x48, 0x81, 0xC4 });                                 // add rsp, xmmBytes
+            emit32(xmmBytes);
+        }
+        for (int reg = 0; reg < 16; ++reg) {
+            if (saved & (1u << reg)) {
+                if (reg >= 8)
+                    emit({ 0x41 });
+                emit({ static_cast<std::uint8_t>(0x58 + (reg & 7)) }); // pop reg
+            }
+        }
+        emit({ 0x9D });                                                 // popfq
+#if !SAFETYHOOK_OS_WINDOWS
+        emit({ 0x48, 0x8D, 0xA4, 0x24, 0x80, 0x00, 0x00, 0x00 });       // lea rsp, [rsp+128]
+#endif
+        emit({ 0xFF, 0x25 });                                           // jmp [rip+trampoline]
+        std::size_t jmpDisp = code.size();
+        emit32(0);
+
+        std::size_t slots = code.size();
+        code.resize(code.size() + 16, 0);
+        auto patch = [&](std::size_t at, std::size_t target) {
+            std::int32_t disp = static_cast<std::int32_t>(target - (at + 4));
+            std::memcpy(code.data() + at, &disp, sizeof(disp));
+        };
+        patch(callDisp, slots);
+        patch(jmpDisp, slots + 8);
+        return code;
+    }
+
+    class Hook
+    {
+    public:
+        using Error = safetyhook::MidHook::Error;
+        using Flags = safetyhook::MidHook::Flags;
+
+        Hook() = default;
+        Hook(Hook&& other) noexcept { *this = std::move(other); }
+
+        Hook& operator=(Hook&& other) noexcept
+        {
+            if (this != &other) {
+                reset();
+                m_stub = std::move(other.m_stub);
+                m_hook = std::move(other.m_hook);
+            }
+            return *this;
+        }
+
+        template<std::uint32_t Mask>
+        static std::expected<Hook, Error> Create(const std::shared_ptr<safetyhook::Allocator>& allocator, void* target, Fn<Mask> destination, Flags flags = safetyhook::MidHook::Default)
+        {
+            return Create(allocator, target, reinterpret_cast<void*>(destination), SavedBy(Mask), flags);
+        }
+
+        static std::expected<Hook, Error> Create(const std::shared_ptr<safetyhook::Allocator>& allocator, void* target, void* destination, std::uint32_t saved, Flags flags)
+        {
+            Hook hook;
+            auto code = BuildStub(saved);
+            auto stub = allocator->allocate(code.size());
+            if (!stub)
+                return std::unexpected{ Error::bad_allocation(stub.error()) };
+            hook.m_stub = std::move(*stub);
+            std::memcpy(hook.m_stub.data(), code.data(), code.size());
+            std::memcpy(hook.m_stub.data() + code.size() - 16, &destination, sizeof(destination));
+
+            // Disabled until the stub knows where the trampoline is
+            auto inlineHook = safetyhook::InlineHook::create(allocator, target, hook.m_stub.data(), safetyhook::InlineHook::StartDisabled);
+            if (!inlineHook)
+                return std::unexpected{ Error::bad_inline_hook(inlineHook.error()) };
+            hook.m_hook = std::move(*inlineHook);
+
+            auto trampoline = hook.m_hook.trampoline().data();
+            std::memcpy(hook.m_stub.data() + code.size() - 8, &trampoline, sizeof(trampoline));
+
+            if (!(flags & safetyhook::MidHook::StartDisabled)) {
+                if (auto result = hook.enable(); !result)
+                    return std::unexpected{ result.error() };
+            }
+            return hook;
+        }
+
+        std::expected<void, Error> enable()
+        {
+            if (auto result = m_hook.enable(); !result)
+                return std::unexpected{ Error::bad_inline_hook(result.error()) };
+            return {};
+        }
+
+        std::expected<void, Error> disable()
+        {
+            if (auto result = m_hook.disable(); !result)
+                return std::unexpected{ Error::bad_inline_hook(result.error()) };
+            return {};
+        }
+
+        bool enabled() const { return m_hook.enabled(); }
+        const auto& original_bytes() const { return m_hook.original_bytes(); }
+
+        void reset()
+        {
+            m_hook = {};
+            m_stub = {};
+        }
+
+    private:
+        // Declared first so the hook is removed before its stub is freed
+        safetyhook::Allocation m_stub;
+        safetyhook::InlineHook m_hook;
+    };
+}
@@ -3,7 +3,7 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include <cassert>
-#include <windows.h>
+#include "platform.hpp"
 #include <fstream>
 #include <iostream>
 #include <inttypes.h>
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs startup work as a dependency graph. A task starts as soon as everything it depends on has finished, on
+// whichever worker is free, so a slow task only holds up the tasks that actually need it. If a task fails (returns
+// false or throws) the tasks depending on it are skipped.
+namespace Tasks
+{
+    enum class Status { Pending, Running, Done, Failed, Skipped };
+
+    inline const char* StatusName(Status status)
+    {
+        switch (status) {
+        case Status::Pending: return "pending";
+        case Status::Running: return "running";
+        case Status::Done: return "done";
+        case Status::Failed: return "failed";
+        case Status::Skipped: return "skipped";
+        }
+        return "unknown";
+    }
+
+    struct Task
+    {
+        std::string name;
+        std::function<bool()> run;
+        std::vector<std::size_t> dependents;
+        std::size_t waitingOn = 0;
+        Status status = Status::Pending;
+        std::chrono::steady_clock::time_point begin{};
+        std::chrono::steady_clock::time_point end{};
+
+        double Milliseconds() const { return std::chrono::duration<double, std::milli>(end - begin).count(); }
+    };
+
+    class Graph
+    {
+    public:
+        // Dependencies must already have been added, which also rules out cycles.
+        std::size_t Add(std::string name, std::function<bool()> run, const std::vector<std::size_t>& dependencies = {})
+        {
+            std::size_t id = m_tasks.size();
+            Task& task = m_tasks.emplace_back();
+            task.name = std::move(name);
+            task.run = std::move(run);
+            for (auto dependency : dependencies) {
+                m_tasks[dependency].dependents.push_back(id);
+                ++m_tasks[id].waitingOn;
+            }
+            return id;
+        }
+
+        // Blocks until every task has finished or been skipped. The calling thread is one of the workers.
+        void Run(unsigned int threads)
+        {
+            {
+                std::scoped_lock lock{ m_mutex };
+                m_begin = std::chrono::steady_clock::now();
+                for (std::size_t id = 0; id < m_tasks.size(); ++id) {
+                    if (!m_tasks[id].waitingOn)
+                        m_ready.push_back(id);
+                }
+            }
+
+            std::vector<std::thread> workers;
+            threads = std::clamp<unsigned int>(threads, 1, (std::max<unsigned int>)(1, static_cast<unsigned int>(m_tasks.size())));
+            for (unsigned int i = 1; i < threads; ++i)
+                workers.emplace_back([this] { Work(); });
+            Work();
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        const std::vector<Task>& Tasks() const { return m_tasks; }
+        std::chrono::steady_clock::time_point Begin() const { return m_begin; }
+
+    private:
+        void Work()
+        {
+            std::unique_lock lock{ m_mutex };
+            while (true) {
+                m_wake.wait(lock, [this] { return !m_ready.empty() || m_finished == m_tasks.size(); });
+                if (m_ready.empty())
+                    return;
+
+                std::size_t id = m_ready.front();
+                m_ready.pop_front();
+                Task& task = m_tasks[id];
+                task.status = Status::Running;
+                task.begin = std::chrono::steady_clock::now();
+                lock.unlock();
+
+                bool bResult = false;
+                try {
+                    bResult = task.run();
+                }
+                catch (...) {
+                    bResult = false;
+                }
+
+                lock.lock();
+                task.end = std::chrono::steady_clock::now();
+                task.status = bResult ? Status::Done : Status::Failed;
+                ++m_finished;
+                if (bResult) {
+                    for (auto dependent : task.dependents) {
+                        if (!--m_tasks[dependent].waitingOn)
+                            m_ready.push_back(dependent);
+                    }
+                }
+                else {
+                    Skip(task.dependents, task.end);
+                }
+                m_wake.notify_all();
+            }
+        }
+
+        void Skip(const std::vector<std::size_t>& ids, std::chrono::steady_clock::time_point when)
+        {
+            for (auto id : ids) {
+                Task& task = m_tasks[id];
+                if (task.status != Status::Pending)
+                    continue;
+                task.status = Status::Skipped;
+                task.begin = task.end = when;
+                ++m_finished;
+                Skip(task.dependents, when);
+            }
+        }
+
+        std::vector<Task> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<std::size_t> m_ready;
+        std::size_t m_finished = 0;
+        std::chrono::steady_clock::time_point m_begin{};
+    };
+}
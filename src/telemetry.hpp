@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "platform.hpp"
+
+// Live values in a named shared memory block, for overlays and profilers running in another process.
+//
+// The fix creates the block and is its only writer. Every field is a lock-free atomic written with plain stores, so
+// publishing costs the game thread a store and readers never hold it up; there is no I/O and nothing to parse. The
+// layout is fixed and versioned: readers check Magic and Version before looking at anything else, and a change to
+// Block has to bump Version. Frame times go into a ring the game thread keeps overwriting. Readers never consume from
+// it, they copy the newest samples and drop any that were overwritten while they copied.
+namespace Telemetry
+{
+    inline constexpr const wchar_t* Name = L"Local\\SotDFixTelemetry";
+    inline constexpr std::uint32_t Magic = 0x54464453;  // "SDFT"
+    inline constexpr std::uint32_t Version = 1;
+    inline constexpr std::size_t MaxHooks = 16;
+    inline constexpr std::size_t FrameRing = 1024;       // About 7 s at 144 fps
+
+    enum class LODState : std::uint32_t { Holding, Raising, Lowering };    // Raising = more detail
+
+    // Resolution and what the fix derived from it. Published together under Block::screenSequence.
+    struct Screen
+    {
+        std::int32_t resX = 0;
+        std::int32_t resY = 0;
+        float aspectRatio = 0.00f;
+        float aspectMultiplier = 1.00f;
+        float fovScale = 1.00f;
+        std::int32_t hudWidth = 0;
+        std::int32_t hudHeight = 0;
+        std::int32_t hudWidthOffset = 0;
+        std::int32_t hudHeightOffset = 0;
+    };
+
+    struct HookEntry
+    {
+        char name[32];
+        std::atomic<std::uint64_t> calls;   // Since startup
+        std::atomic<float> p99;             // ns, over the last Hook Stats interval
+        std::atomic<float> max;             // ns, since startup
+    };
+
+    struct Block
+    {
+        // Written once while magic is 0, readable once it isn't
+        std::atomic<std::uint32_t> magic;
+        std::uint32_t version;
+        std::uint32_t size;                 // sizeof(Block)
+        std::uint32_t processId;
+        char fixName[16];
+        char fixVersion[16];
+
+        // Odd while the fields below it are being written
+        std::atomic<std::uint32_t> screenSequence;
+        std::atomic<std::int32_t> resX;
+        std::atomic<std::int32_t> resY;
+        std::atomic<float> aspectRatio;
+        std::atomic<float> aspectMultiplier;
+        std::atomic<float> fovScale;
+        std::atomic<std::int32_t> hudWidth;
+        std::atomic<std::int32_t> hudHeight;
+        std::atomic<std::int32_t> hudWidthOffset;
+        std::atomic<std::int32_t> hudHeightOffset;
+
+        std::atomic<float> frameLimit;      // fps, 0 when frames aren't paced by the fix
+        std::atomic<float> lodFactor;
+        std::atomic<std::uint32_t> lodState;
+
+        std::atomic<std::uint32_t> patchesLive;
+        std::atomic<std::uint32_t> hooksLive;
+        std::atomic<std::uint32_t> hookCount;   // Entries of hooks with a name, only filled in with Hook Stats enabled
+        std::uint32_t reserved;
+        HookEntry hooks[MaxHooks];
+
+        // Frames recorded. Frame n's time is frameTimes[n % FrameRing], in ms.
+        std::atomic<std::uint64_t> frames;
+        std::atomic<float> frameTimes[FrameRing];
+    };
+
+    // The layout is shared between processes and compilers
+    static_assert(std::is_standard_layout_v<Block>);
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<float>::is_always_lock_free);
+    static_assert(sizeof(std::atomic<float>) == 4 && sizeof(HookEntry) == 48);
+    static_assert(offsetof(Block, hooks) == 120 && sizeof(Block) == 4992);
+
+    // Fix side.
+    class Writer
+    {
+    public:
+        Writer() = default;
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        ~Writer()
+        {
+            if (m_block)
+                UnmapViewOfFile(m_block);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+        }
+
+        // Creates the block, or takes over one a reader still holds from a previous session. Until this succeeds
+        // every other call does nothing.
+        bool Create(const wchar_t* name, const std::string& fixName, const std::string& fixVersion)
+        {
+            m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Block), name);
+            if (!m_mapping)
+                return false;
+            m_bTakenOver = GetLastError() == ERROR_ALREADY_EXISTS;
+
+            auto block = static_cast<Block*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Block)));
+            if (!block) {
+                CloseHandle(m_mapping);
+                m_mapping = NULL;
+                return false;
+            }
+
+            // Readers of a previous session see magic go to 0 and re-check everything once it is back
+            block->magic.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memset(reinterpret_cast<char*>(block) + sizeof(block->magic), 0, sizeof(Block) - sizeof(block->magic));
+            block->version = Version;
+            block->size = sizeof(Block);
+            block->processId = GetCurrentProcessId();
+            fixName.copy(block->fixName, sizeof(block->fixName) - 1);
+            fixVersion.copy(block->fixVersion, sizeof(block->fixVersion) - 1);
+            block->magic.store(Magic, std::memory_order_release);
+
+            m_block = block;
+            return true;
+        }
+
+        bool Active() const { return m_block != nullptr; }
+        bool TakenOver() const { return m_bTakenOver; }
+
+        // One caller at a time.
+        void SetScreen(const Screen& screen)
+        {
+            if (!m_block)
+                return;
+            auto sequence = m_block->screenSequence.load(std::memory_order_relaxed);
+            m_block->screenSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_block->resX.store(screen.resX, std::memory_order_relaxed);
+            m_block->resY.store(screen.resY, std::memory_order_relaxed);
+            m_block->aspectRatio.store(screen.aspectRatio, std::memory_order_relaxed);
+            m_block->aspectMultiplier.store(screen.aspectMultiplier, std::memory_order_relaxed);
+            m_block->fovScale.store(screen.fovScale, std::memory_order_relaxed);
+            m_block->hudWidth.store(screen.hudWidth, std::memory_order_relaxed);
+            m_block->hudHeight.store(screen.hudHeight, std::memory_order_relaxed);
+            m_block->hudWidthOffset.store(screen.hudWidthOffset, std::memory_order_relaxed);
+            m_block->hudHeightOffset.store(screen.hudHeightOffset, std::memory_order_relaxed);
+            m_block->screenSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        void SetFrameLimit(float fFPS)
+        {
+            if (m_block)
+                m_block->frameLimit.store(fFPS, std::memory_order_relaxed);
+        }
+
+        void SetLOD(float fFactor, LODState state)
+        {
+            if (!m_block)
+                return;
+            m_block->lodFactor.store(fFactor, std::memory_order_relaxed);
+            m_block->lodState.store(static_cast<std::uint32_t>(state), std::memory_order_relaxed);
+        }
+
+        // Any thread, features apply their patches concurrently.
+        void AddApplied(std::size_t patches, std::size_t hooks)
+        {
+            if (!m_block)
+                return;
+            m_block->patchesLive.fetch_add(static_cast<std::uint32_t>(patches), std::memory_order_relaxed);
+            m_block->hooksLive.fetch_add(static_cast<std::uint32_t>(hooks), std::memory_order_relaxed);
+        }
+
+        // Hook Stats thread. Ids are the order hooks were registered in, the name is written the first time.
+        void SetHook(std::size_t id, const char* name, std::uint64_t calls, double p99, double max)
+        {
+            if (!m_block || id >= MaxHooks)
+                return;
+            auto& entry = m_block->hooks[id];
+            if (id >= m_block->hookCount.load(std::memory_order_relaxed)) {
+                std::strncpy(entry.name, name, sizeof(entry.name) - 1);
+                m_block->hookCount.store(static_cast<std::uint32_t>(id + 1), std::memory_order_release);
+            }
+            entry.calls.store(calls, std::memory_order_relaxed);
+            entry.p99.store(static_cast<float>(p99), std::memory_order_relaxed);
+            entry.max.store(static_cast<float>(max), std::memory_order_relaxed);
+        }
+
+        // Game thread, once per frame. Two stores.
+        void Frame()
+        {
+            if (!m_block)
+                return;
+            auto now = std::chrono::steady_clock::now();
+            if (m_bStarted) {
+                auto frames = m_block->frames.load(std::memory_order_relaxed);
+                m_block->frameTimes[frames % FrameRing].store(std::chrono::duration<float, std::milli>(now - m_previous).count(), std::memory_order_relaxed);
+                m_block->frames.store(frames + 1, std::memory_order_release);
+            }
+            m_bStarted = true;
+            m_previous = now;
+        }
+
+    private:
+        HANDLE m_mapping = NULL;
+        Block* m_block = nullptr;
+        bool m_bTakenOver = false;
+
+        // Game thread
+        bool m_bStarted = false;
+        std::chrono::steady_clock::time_point m_previous{};
+    };
+
+    // Overlay or profiler side. Maps the block read-only.
+    class Reader
+    {
+    public:
+        Reader() = default;
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        ~Reader() { Close(); }
+
+        // Fails if there is no block yet, or it is of another version.
+        bool Open(const wchar_t* name)
+        {
+            Close();
+            m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+            if (!m_mapping)
+                return false;
+            m_block = static_cast<const Block*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(Block)));
+            if (!m_block || !Valid()) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        void Close()
+        {
+            if (m_block)
+                UnmapViewOfFile(m_block);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            m_block = nullptr;
+            m_mapping = NULL;
+        }
+
+        // False while the fix is (re)initialising the block.
+        bool Valid() const
+        {
+            return m_block && m_block->magic.load(std::memory_order_acquire) == Magic && m_block->version == Version && m_block->size == sizeof(Block);
+        }
+
+        const Block& Get() const { return *m_block; }
+
+        Screen GetScreen() const
+        {
+            Screen screen;
+            std::uint32_t before = 0, after = 0;
+            do {
+                before = m_block->screenSequence.load(std::memory_order_acquire);
+                screen.resX = m_block->resX.load(std::memory_order_relaxed);
+                screen.resY = m_block->resY.load(std::memory_order_relaxed);
+                screen.aspectRatio = m_block->aspectRatio.load(std::memory_order_relaxed);
+                screen.aspectMultiplier = m_block->aspectMultiplier.load(std::memory_order_relaxed);
+                screen.fovScale = m_block->fovScale.load(std::memory_order_relaxed);
+                screen.hudWidth = m_block->hudWidth.load(std::memory_order_relaxed);
+                screen.hudHeight = m_block->hudHeight.load(std::memory_order_relaxed);
+                screen.hudWidthOffset = m_block->hudWidthOffset.load(std::memory_order_relaxed);
+                screen.hudHeightOffset = m_block->hudHeightOffset.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_block->screenSequence.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+            return screen;
+        }
+
+        // Appends the times of the frames recorded since frame "since" that are still in the ring, oldest first, and
+        // returns the frame count to pass next time.
+        std::uint64_t FramesSince(std::uint64_t since, std::vector<float>& out) const
+        {
+            auto end = m_block->frames.load(std::memory_order_acquire);
+            auto begin = (std::max)(since, end > FrameRing ? end - FrameRing : 0);
+            std::size_t first = out.size();
+            for (auto frame = begin; frame < end; ++frame)
+                out.push_back(m_block->frameTimes[frame % FrameRing].load(std::memory_order_relaxed));
+
+            // Frame n's slot is rewritten before frame n + FrameRing is counted
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto now = m_block->frames.load(std::memory_order_relaxed);
+            if (now + 1 > begin + FrameRing) {
+                auto overwritten = (std::min<std::uint64_t>)(now + 1 - FrameRing - begin, end - begin);
+                out.erase(out.begin() + first, out.begin() + first + static_cast<std::ptrdiff_t>(overwritten));
+            }
+            return end;
+        }
+
+    private:
+        HANDLE m_mapping = NULL;
+        const Block* m_block = nullptr;
+    };
+}
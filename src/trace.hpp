@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scoped startup tracing. Each Trace::Scope records one complete event which can be written out as Chrome
+// trace-event JSON (chrome://tracing, Perfetto). When tracing is disabled a scope costs a single atomic load.
+namespace Trace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Trace timestamps are relative to when the fix was loaded
+    inline const Clock::time_point Origin = Clock::now();
+
+    struct Event
+    {
+        std::string name;
+        const char* category;
+        std::int64_t begin;     // ns since Origin
+        std::int64_t duration;  // ns
+        std::uint32_t thread;
+        std::string args;       // JSON members, e.g. "bytes":123,"matches":1
+    };
+
+    inline std::atomic<bool> Enabled{ true };
+    inline std::mutex Mutex;
+    inline std::vector<Event> Events;
+
+    inline std::int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - Origin).count();
+    }
+
+    // Small sequential ids read better in the trace viewer than OS thread ids
+    inline std::uint32_t ThreadId()
+    {
+        static std::atomic<std::uint32_t> nextId{ 1 };
+        thread_local std::uint32_t id = nextId++;
+        return id;
+    }
+
+    // Events are recorded from the start so the phases before the config is read are covered, disabling drops them.
+    inline void Enable(bool bEnable)
+    {
+        Enabled = bEnable;
+        if (!bEnable) {
+            std::scoped_lock lock{ Mutex };
+            Events.clear();
+        }
+    }
+
+    inline void Escape(std::string& out, std::string_view text)
+    {
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                out += c;
+        }
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(std::string_view name, const char* category = "phase")
+        {
+            if (!Enabled.load(std::memory_order_relaxed))
+                return;
+            m_active = true;
+            m_name = name;
+            m_category = category;
+            m_begin = Now();
+        }
+
+        ~Scope()
+        {
+            if (!m_active)
+                return;
+            Event event{ std::move(m_name), m_category, m_begin, Now() - m_begin, ThreadId(), std::move(m_args) };
+            std::scoped_lock lock{ Mutex };
+            Events.push_back(std::move(event));
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void Arg(std::string_view key, std::uint64_t value)
+        {
+            if (!m_active)
+                return;
+            AppendKey(key);
+            std::format_to(std::back_inserter(m_args), "{}", value);
+        }
+
+        void Arg(std::string_view key, std::string_view value)
+        {
+            if (!m_active)
+                return;
+            AppendKey(key);
+            m_args += '"';
+            Escape(m_args, value);
+            m_args += '"';
+        }
+
+    private:
+        void AppendKey(std::string_view key)
+        {
+            if (!m_args.empty())
+                m_args += ',';
+            m_args += '"';
+            Escape(m_args, key);
+            m_args += "\":";
+        }
+
+        bool m_active = false;
+        std::string m_name;
+        const char* m_category = nullptr;
+        std::int64_t m_begin = 0;
+        std::string m_args;
+    };
+
+    inline bool Write(const std::filesystem::path& path)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+            return false;
+
+        std::scoped_lock lock{ Mutex };
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (std::size_t i = 0; i < Events.size(); ++i) {
+            const auto& event = Events[i];
+            json += i ? ",\n" : "\n";
+            json += "{\"name\":\"";
+            Escape(json, event.name);
+            std::format_to(std::back_inserter(json), "\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{},\"args\":{{{}}}}}",
+                event.category, event.begin / 1000.0, event.duration / 1000.0, event.thread, event.args);
+        }
+        json += "\n]}\n";
+        file << json;
+        return static_cast<bool>(file);
+    }
+
+    // One line covering the top-level phases, e.g. "12.40 ms: Logging 1.02 ms, Configuration 0.31 ms, ..."
+    inline std::string Summary()
+    {
+        std::scoped_lock lock{ Mutex };
+        std::string phases;
+        std::int64_t end = 0;
+        for (const auto& event : Events) {
+            end = (std::max)(end, event.begin + event.duration);
+            if (std::string_view(event.category) != "phase")
+                continue;
+            if (!phases.empty())
+                phases += ", ";
+            std::format_to(std::back_inserter(phases), "{} {:.2f} ms", event.name, event.duration / 1e6);
+        }
+        return std::format("{:.2f} ms: {}", end / 1e6, phases);
+    }
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "stdafx.h"
+#include "slimhook.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <safetyhook.hpp>
+
+namespace safetyhook
+{
+    // Defined in safetyhook.cpp. Calls made from inside run_fn reuse the freeze instead of taking another one.
+    void execute_while_frozen(const std::function<void()>& run_fn, const std::function<void(std::uint32_t, void*, void*)>& visit_fn);
+}
+
+namespace Memory
+{
+    // Collects the byte patches and hooks of a feature and applies them together: all game threads are frozen once,
+    // each run of pages sharing a protection is unprotected once, and everything is rolled back if any step fails.
+    // A transaction is committed once. Commits from different threads are serialised, staging is not thread safe.
+    //
+    // Parts of a feature that don't need each other go in separate batches. A batch whose hook can't be created, or
+    // whose patches and hooks overlap another batch's, is left out with a note in Error() and the rest still commits.
+    class Transaction
+    {
+    public:
+        void PatchBytes(std::uint8_t* address, const char* pattern, unsigned int numBytes)
+        {
+            m_patches.push_back({ address, std::vector<std::uint8_t>(pattern, pattern + numBytes), {}, m_batch });
+        }
+
+        template<typename T>
+        void Write(std::uint8_t* writeAddress, T value)
+        {
+            PatchBytes(writeAddress, reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void MidHook(SafetyHookMid& hook, std::uint8_t* target, safetyhook::MidHookFn destination)
+        {
+            m_hooks.push_back({ &hook, nullptr, nullptr, target, destination, nullptr, 0, m_batch });
+        }
+
+        void InlineHook(SafetyHookInline& hook, std::uint8_t* target, void* destination)
+        {
+            m_hooks.push_back({ nullptr, &hook, nullptr, target, nullptr, destination, 0, m_batch });
+        }
+
+        template<std::uint32_t Mask>
+        void SlimHook(SlimHook::Hook& hook, std::uint8_t* target, SlimHook::Fn<Mask> destination)
+        {
+            m_hooks.push_back({ nullptr, nullptr, &hook, target, nullptr, reinterpret_cast<void*>(destination), SlimHook::SavedBy(Mask), m_batch });
+        }
+
+        // Runs after a successful commit of the current batch, for state that must only change once its patches are live
+        void OnCommit(std::function<void()> fn)
+        {
+            m_onCommit.push_back({ std::move(fn), m_batch });
+        }
+
+        // Everything staged from here on is a new batch
+        void Batch()
+        {
+            ++m_batch;
+        }
+
+        std::size_t Patches() const { return m_patches.size(); }
+        std::size_t Hooks() const { return m_hooks.size(); }
+        const std::string& Error() const { return m_error; }
+
+        bool Commit()
+        {
+            if (m_committed) {
+                m_error = "Transaction has already been committed.";
+                return false;
+            }
+            m_committed = true;
+            if (m_patches.empty() && m_hooks.empty()) {
+                RunOnCommit();
+                return true;
+            }
+
+            // Build the hooks disabled, this allocates and decodes so it has to happen before the freeze
+            for (auto& hook : m_hooks) {
+                Trace::Scope trace("Create hook", "hook");
+                trace.Arg("target", std::format("{:x}", (uintptr_t)hook.target));
+                bool bCreated = false;
+                if (hook.mid) {
+                    auto result = SafetyHookMid::create(safetyhook::Allocator::global(), hook.target, hook.midFn, SafetyHookMid::StartDisabled);
+                    if ((bCreated = result.has_value()))
+                        *hook.mid = std::move(*result);
+                }
+                else if (hook.slim) {
+                    auto result = SlimHook::Hook::Create(safetyhook::Allocator::global(), hook.target, hook.destination, hook.saved, SafetyHookMid::StartDisabled);
+                    if ((bCreated = result.has_value()))
+                        *hook.slim = std::move(*result);
+                }
+                else {
+                    auto result = SafetyHookInline::create(safetyhook::Allocator::global(), hook.target, hook.destination, SafetyHookInline::StartDisabled);
+                    if ((bCreated = result.has_value()))
+                        *hook.inlineHook = std::move(*result);
+                }
+
+                if (!bCreated)
+                    Reject(hook.batch, std::format("Failed to create hook at {:x}.", (uintptr_t)hook.target));
+            }
+
+            // A hook copies the original bytes into its trampoline, so a patch inside them would be lost. The batch
+            // staged later is the one left out.
+            for (const auto& patch : m_patches) {
+                for (const auto& hook : m_hooks) {
+                    if (Rejected(patch.batch) || Rejected(hook.batch))
+                        continue;
+                    std::size_t hookSize = hook.mid ? hook.mid->original_bytes().size() : hook.slim ? hook.slim->original_bytes().size() : hook.inlineHook->original_bytes().size();
+                    if (patch.address < hook.target + hookSize && hook.target < patch.address + patch.bytes.size())
+                        Reject((std::max)(patch.batch, hook.batch), std::format("Patch at {:x} overlaps hook at {:x}.", (uintptr_t)patch.address, (uintptr_t)hook.target));
+                }
+            }
+
+            // Drop rejected batches, then carry on with what's left
+            if (!m_rejected.empty()) {
+                for (auto& hook : m_hooks) {
+                    if (Rejected(hook.batch))
+                        ResetHook(hook);
+                }
+                std::erase_if(m_patches, [this](const Patch& patch) { return Rejected(patch.batch); });
+                std::erase_if(m_hooks, [this](const Hook& hook) { return Rejected(hook.batch); });
+                if (m_patches.empty() && m_hooks.empty())
+                    return false;
+            }
+
+            for (auto& patch : m_patches)
+                patch.original.assign(patch.address, patch.address + patch.bytes.size());
+
+            BuildSpans();
+
+            Trace::Scope trace("Apply patches", "hook");
+            trace.Arg("patches", m_patches.size());
+            trace.Arg("hooks", m_hooks.size());
+            trace.Arg("spans", m_spans.size());
+
+            // Two threads freezing each other at the same time would both end up suspended
+            static std::mutex freezeMutex;
+            std::scoped_lock freezeLock{ freezeMutex };
+
+            // Nothing below may allocate: a frozen thread could be holding the heap lock
+            std::size_t failedSpan = m_spans.size();
+            std::size_t failedHook = m_hooks.size();
+            safetyhook::execute_while_frozen(
+                [&] {
+                    for (std::size_t i = 0; i < m_spans.size(); ++i) {
+                        if (!VirtualProtect(m_spans[i].address, m_spans[i].size, m_spans[i].executable ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE, &m_spans[i].protect)) {
+                            failedSpan = i;
+                            break;
+                        }
+                    }
+
+                    if (failedSpan == m_spans.size()) {
+                        for (const auto& patch : m_patches)
+                            memcpy(patch.address, patch.bytes.data(), patch.bytes.size());
+
+                        for (std::size_t i = 0; i < m_hooks.size(); ++i) {
+                            if (!EnableHook(m_hooks[i])) {
+                                failedHook = i;
+                                break;
+                            }
+                        }
+
+                        // Roll back
+                        if (failedHook != m_hooks.size()) {
+                            for (std::size_t i = 0; i < failedHook; ++i)
+                                DisableHook(m_hooks[i]);
+                            for (const auto& patch : m_patches)
+                                memcpy(patch.address, patch.original.data(), patch.original.size());
+                        }
+                    }
+
+                    DWORD oldProtect;
+                    for (std::size_t i = 0; i < (std::min)(failedSpan, m_spans.size()); ++i)
+                        VirtualProtect(m_spans[i].address, m_spans[i].size, m_spans[i].protect, &oldProtect);
+                },
+                {});
+
+            // Nothing went live, so nothing staged is kept
+            if (failedSpan != m_spans.size()) {
+                m_error = std::format("Failed to unprotect {:x}.", (uintptr_t)m_spans[failedSpan].address);
+                ResetHooks();
+                return false;
+            }
+            if (failedHook != m_hooks.size()) {
+                m_error = std::format("Failed to enable hook at {:x}.", (uintptr_t)m_hooks[failedHook].target);
+                ResetHooks();
+                return false;
+            }
+            RunOnCommit();
+            return true;
+        }
+
+    private:
+        struct Patch
+        {
+            std::uint8_t* address;
+            std::vector<std::uint8_t> bytes;
+            std::vector<std::uint8_t> original;
+            std::size_t batch;
+        };
+
+        struct Hook
+        {
+            SafetyHookMid* mid;
+            SafetyHookInline* inlineHook;
+            SlimHook::Hook* slim;
+            std::uint8_t* target;
+            safetyhook::MidHookFn midFn;
+            void* destination;
+            std::uint32_t saved;    // Registers a slim hook's stub saves
+            std::size_t batch;
+        };
+
+        // Contiguous pages with a single protection, unprotected with one VirtualProtect call. Data pages are only
+        // made writable, not executable.
+        struct Span
+        {
+            std::uint8_t* address;
+            std::size_t size;
+            DWORD protect;
+            bool executable;
+        };
+
+        struct Callback
+        {
+            std::function<void()> fn;
+            std::size_t batch;
+        };
+
+        static bool EnableHook(Hook& hook)
+        {
+            if (hook.mid)
+                return hook.mid->enable().has_value();
+            if (hook.slim)
+                return hook.slim->enable().has_value();
+            return hook.inlineHook->enable().has_value();
+        }
+
+        static void DisableHook(Hook& hook)
+        {
+            if (hook.mid)
+                (void)hook.mid->disable();
+            else if (hook.slim)
+                (void)hook.slim->disable();
+            else
+                (void)hook.inlineHook->disable();
+        }
+
+        void RunOnCommit()
+        {
+            for (const auto& callback : m_onCommit) {
+                if (!Rejected(callback.batch))
+                    callback.fn();
+            }
+        }
+
+        bool Rejected(std::size_t batch) const
+        {
+            return std::find(m_rejected.begin(), m_rejected.end(), batch) != m_rejected.end();
+        }
+
+        void Reject(std::size_t batch, const std::string& reason)
+        {
+            if (Rejected(batch))
+                return;
+            m_rejected.push_back(batch);
+            m_error += m_error.empty() ? reason : " " + reason;
+        }
+
+        static void ResetHook(Hook& hook)
+        {
+            if (hook.mid)
+                hook.mid->reset();
+            else if (hook.slim)
+                hook.slim->reset();
+            else
+                hook.inlineHook->reset();
+        }
+
+        void ResetHooks()
+        {
+            for (auto& hook : m_hooks)
+                ResetHook(hook);
+        }
+
+        void BuildSpans()
+        {
+            SYSTEM_INFO systemInfo{};
+            GetSystemInfo(&systemInfo);
+            const std::uintptr_t pageSize = systemInfo.dwPageSize;
+
+            std::vector<std::uintptr_t> pages;
+            for (const auto& patch : m_patches) {
+                auto first = (std::uintptr_t)patch.address & ~(pageSize - 1);
+                auto last = ((std::uintptr_t)patch.address + patch.bytes.size() - 1) & ~(pageSize - 1);
+                for (auto page = first; page <= last; page += pageSize)
+                    pages.push_back(page);
+            }
+            std::sort(pages.begin(), pages.end());
+            pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+            // Extend the previous span while the next page follows it inside the same VirtualQuery region
+            m_spans.clear();
+            std::uintptr_t regionEnd = 0;
+            for (auto page : pages) {
+                if (!m_spans.empty() && (std::uintptr_t)m_spans.back().address + m_spans.back().size == page && page < regionEnd) {
+                    m_spans.back().size += pageSize;
+                    continue;
+                }
+
+                MEMORY_BASIC_INFORMATION mbi{};
+                regionEnd = VirtualQuery((LPCVOID)page, &mbi, sizeof(mbi)) ? (std::uintptr_t)mbi.BaseAddress + mbi.RegionSize : 0;
+                bool bExecutable = !regionEnd || (mbi.Protect & (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY));
+                m_spans.push_back({ (std::uint8_t*)page, pageSize, 0, bExecutable });
+            }
+        }
+
+        std::vector<Patch> m_patches;
+        std::vector<Hook> m_hooks;
+        std::vector<Span> m_spans;
+        std::vector<Callback> m_onCommit;
+        std::vector<std::size_t> m_rejected;
+        std::string m_error;
+        std::size_t m_batch = 0;
+        bool m_committed = false;
+    };
+}
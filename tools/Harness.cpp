@@ -0,0 +1,513 @@
+// Harness: runs the fix's whole startup on Linux (config, signature scan, patches and hooks) against a PE image mapped
+// into the process the way the loader would, and reports how long it took and what was changed.
+//
+// Needs x64 Linux, the spdlog and inipp submodules, and Zydis.c, the amalgamated C source of Zydis 4.0 that belongs
+// next to Zydis.h in external/safetyhook. SotDFix.vcxproj compiles the same file; take it from the safetyhook
+// amalgamation Zydis.h came from. Build with:
+//   gcc -c -O2 -Iexternal/safetyhook external/safetyhook/Zydis.c -o Zydis.o
+//   g++ -std=c++23 -O2 -pthread -Isrc -Iexternal/safetyhook -Iexternal/spdlog/include -Iexternal/inipp
+//       tools/Harness.cpp external/safetyhook/safetyhook.cpp Zydis.o -o Harness
+//
+// Usage:
+//   Harness [--image <executable> | --synthetic] [--config SotDFix.ini] [--desktop 3440x1440] [--runs 5]
+//           [--work <directory>] [--keep-cache] [--late <signature> [--late-after 500]]
+//
+// dllmain.cpp is compiled into the harness, on top of the POSIX side of platform.hpp. Each run is a fresh fork()ed
+// process that maps the image, points the fix's module handles at it and calls Main() the way the loader thread
+// would. The image is either a real executable or a synthetic PE32+ with every signature planted once in .text,
+// padded with NOPs and with wildcards filled so the planted code decodes. The config is copied into the work
+// directory, where the fix also writes its log, scan cache and trace. The scan cache is deleted before each run
+// unless --keep-cache is given, so by default every run scans.
+//
+// --late hides one signature's code when the image is mapped and writes it back from another thread --late-after ms
+// into the run, the way a game that unpacks code after the DLL loaded would. The run then waits up to 30 s for the
+// background rescanner to find it and patch it.
+//
+// Reported: for the first run, every signature's RVA and how many bytes around it the fix changed; for all runs,
+// the time Main() took and how long after it started the first and last patch went live, as min / median / max.
+// Per-call hook overhead needs code that actually runs, see HookBench. If the linked decoder gets a plain lea wrong,
+// it isn't Zydis and the timings are flagged as not representative; the patch checks still hold.
+//
+// Exit code: 0 if every run finished, 2 if a run failed or a signature the config enables wasn't patched, 1 on bad
+// arguments or an unreadable image.
+
+#include "dllmain.cpp"
+
+#include <Zydis.h>
+
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::filesystem::path image;
+        std::filesystem::path config = "SotDFix.ini";
+        std::filesystem::path work = std::filesystem::temp_directory_path() / "SotDFixHarness";
+        DWORD desktopWidth = 3440;
+        DWORD desktopHeight = 1440;
+        int runs = 5;
+        bool bKeepCache = false;
+        std::string late;
+        int lateAfter = 500;
+    };
+
+    // One run's numbers, sent from the child to the parent through a pipe
+    struct RunResult
+    {
+        double mainMs = 0.0;
+        double firstPatchMs = 0.0;
+        double lastPatchMs = 0.0;
+        double lateMs = -1.0;       // When the late signature was patched, -1 if it wasn't
+        int unpatched = 0;
+    };
+
+    constexpr std::uint32_t SectionExecute = 0x20000000;
+    constexpr std::uint32_t SectionRead = 0x40000000;
+    constexpr std::uint32_t SectionWrite = 0x80000000;
+
+    struct Section
+    {
+        std::uint32_t offset;
+        std::uint32_t size;
+        std::uint32_t characteristics;
+    };
+
+    struct Image
+    {
+        std::vector<std::uint8_t> data;
+        std::vector<Section> sections;
+        std::uint32_t headersSize = 0x1000;
+    };
+
+    template<typename T>
+    bool Read(const std::vector<std::uint8_t>& file, std::size_t offset, T& value)
+    {
+        if (offset > file.size() || file.size() - offset < sizeof(T))
+            return false;
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return true;
+    }
+
+    template<typename T>
+    void Store(std::uint8_t* data, T value) { std::memcpy(data, &value, sizeof(T)); }
+
+    bool LoadImage(const std::filesystem::path& path, Image& image, std::string& error)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) {
+            error = "could not open file";
+            return false;
+        }
+        std::vector<std::uint8_t> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+        IMAGE_DOS_HEADER dosHeader{};
+        IMAGE_NT_HEADERS ntHeaders{};
+        if (!Read(file, 0, dosHeader) || dosHeader.e_magic != IMAGE_DOS_SIGNATURE || !Read(file, dosHeader.e_lfanew, ntHeaders) ||
+            ntHeaders.Signature != IMAGE_NT_SIGNATURE) {
+            error = "not a PE file";
+            return false;
+        }
+        if (ntHeaders.OptionalHeader.Magic != 0x20B) {
+            error = "not a PE32+ file, the fix is x64 only";
+            return false;
+        }
+
+        const auto& optionalHeader = ntHeaders.OptionalHeader;
+        image.data.assign(optionalHeader.SizeOfImage, 0);
+        image.headersSize = (std::min)(optionalHeader.SizeOfHeaders, optionalHeader.SizeOfImage);
+        std::memcpy(image.data.data(), file.data(), (std::min<std::size_t>)(image.headersSize, file.size()));
+
+        std::size_t sectionHeader = dosHeader.e_lfanew + offsetof(IMAGE_NT_HEADERS, OptionalHeader) + ntHeaders.FileHeader.SizeOfOptionalHeader;
+        for (WORD i = 0; i < ntHeaders.FileHeader.NumberOfSections; ++i, sectionHeader += 0x28) {
+            std::uint32_t virtualSize = 0, virtualAddress = 0, sizeOfRawData = 0, pointerToRawData = 0, characteristics = 0;
+            if (!Read(file, sectionHeader + 0x8, virtualSize) || !Read(file, sectionHeader + 0xC, virtualAddress) ||
+                !Read(file, sectionHeader + 0x10, sizeOfRawData) || !Read(file, sectionHeader + 0x14, pointerToRawData) ||
+                !Read(file, sectionHeader + 0x24, characteristics)) {
+                error = "truncated section table";
+                return false;
+            }
+            if (virtualAddress >= optionalHeader.SizeOfImage)
+                continue;
+
+            std::uint32_t mappedSize = (std::min)(virtualSize ? virtualSize : sizeOfRawData, optionalHeader.SizeOfImage - virtualAddress);
+            image.sections.push_back({ virtualAddress, mappedSize, characteristics });
+            if (pointerToRawData < file.size()) {
+                std::size_t size = (std::min<std::size_t>)({ sizeOfRawData, mappedSize, file.size() - pointerToRawData });
+                std::memcpy(image.data.data() + virtualAddress, file.data() + pointerToRawData, size);
+            }
+        }
+        return true;
+    }
+
+    // True if the linked decoder is Zydis rather than a stand-in: "lea rax, [rdi+1]" has to come out whole
+    bool RealDecoder()
+    {
+        const std::uint8_t lea[] = { 0x48, 0x8D, 0x47, 0x01 };
+        ZydisDecoder decoder;
+        ZydisDecodedInstruction instruction;
+        return ZYAN_SUCCESS(ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64))
+            && ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(&decoder, nullptr, lea, sizeof(lea), &instruction))
+            && instruction.mnemonic == ZYDIS_MNEMONIC_LEA && instruction.length == sizeof(lea) && instruction.raw.disp.value == 1;
+    }
+
+    // True if the bytes decode as x64 instructions all the way through, as the hooks will need
+    bool Decodes(const std::uint8_t* code, std::size_t size)
+    {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+        for (std::size_t offset = 0; offset < size;) {
+            ZydisDecodedInstruction instruction;
+            if (ZYAN_FAILED(ZydisDecoderDecodeInstruction(&decoder, nullptr, code + offset, size - offset, &instruction)))
+                return false;
+            offset += instruction.length;
+        }
+        return true;
+    }
+
+    // 4 MB: .text of int3 with every signature planted once, then .rdata and .data
+    Image BuildSyntheticImage()
+    {
+        constexpr std::uint32_t size = 4 << 20;
+        constexpr std::uint32_t textSize = 3 << 20;
+        constexpr std::uint32_t rdataSize = 512 << 10;
+        constexpr std::size_t slot = 512;
+        constexpr std::size_t sled = 64;
+
+        Image image;
+        image.data.assign(size, 0);
+        image.sections = {
+            { 0x1000, textSize - 0x1000, SectionExecute | SectionRead | 0x20 },
+            { textSize, rdataSize, SectionRead | 0x40 },
+            { textSize + rdataSize, size - textSize - rdataSize, SectionRead | SectionWrite | 0x40 },
+        };
+
+        auto data = image.data.data();
+        Store<std::uint16_t>(data, IMAGE_DOS_SIGNATURE);
+        Store<std::uint32_t>(data + 0x3C, 0x80);
+        auto nt = data + 0x80;
+        Store<std::uint32_t>(nt, IMAGE_NT_SIGNATURE);
+        Store<std::uint16_t>(nt + 0x4, 0x8664);
+        Store<std::uint16_t>(nt + 0x6, static_cast<std::uint16_t>(image.sections.size()));
+        Store<std::uint32_t>(nt + 0x8, 0x5EED0001);
+        Store<std::uint16_t>(nt + 0x14, 0xF0);
+        Store<std::uint16_t>(nt + 0x18, 0x20B);
+        Store<std::uint32_t>(nt + 0x18 + 0x38, size);
+        Store<std::uint32_t>(nt + 0x18 + 0x3C, 0x1000);
+
+        static const char* names[] = { ".text", ".rdata", ".data" };
+        auto sectionHeader = nt + 0x18 + 0xF0;
+        for (std::size_t i = 0; i < image.sections.size(); ++i, sectionHeader += 0x28) {
+            std::memcpy(sectionHeader, names[i], std::strlen(names[i]));
+            Store<std::uint32_t>(sectionHeader + 0x8, image.sections[i].size);
+            Store<std::uint32_t>(sectionHeader + 0xC, image.sections[i].offset);
+            Store<std::uint32_t>(sectionHeader + 0x24, image.sections[i].characteristics);
+        }
+
+        const auto& text = image.sections[0];
+        std::memset(data + text.offset, 0xCC, text.size);
+
+        // A NOP sled in front so hooks placed before a match start on an instruction boundary, then the signature,
+        // then NOPs and a ret. Wildcards are refilled until the whole slot decodes.
+        std::mt19937 random(1);
+        const std::size_t count = std::size(Signature::All);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& pattern = Signature::All[i].pattern;
+            auto out = data + text.offset + (text.size * (i + 1) / (count + 1)) / slot * slot;
+            std::memset(out, 0x90, slot - 1);
+            out[slot - 1] = 0xC3;
+
+            for (int attempt = 0; attempt < 1000; ++attempt) {
+                for (std::size_t n = 0; n < pattern.size; ++n)
+                    out[sled + n] = pattern.mask[n] ? pattern.bytes[n] : static_cast<std::uint8_t>(random());
+                if (Decodes(out, slot))
+                    break;
+            }
+        }
+        return image;
+    }
+
+    // Maps the image with each section's protection, as the loader would. Never unmapped, the fix keeps using it.
+    std::uint8_t* MapImage(const Image& image)
+    {
+        void* mapping = mmap(nullptr, image.data.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+            return nullptr;
+
+        auto base = static_cast<std::uint8_t*>(mapping);
+        std::memcpy(base, image.data.data(), image.data.size());
+        mprotect(base, image.headersSize, PROT_READ);
+
+        const auto pageSize = Platform::PageSize();
+        for (const auto& section : image.sections) {
+            int protection = (section.characteristics & SectionRead ? PROT_READ : 0) | (section.characteristics & SectionWrite ? PROT_WRITE : 0) |
+                (section.characteristics & SectionExecute ? PROT_EXEC : 0);
+            std::size_t size = (section.size + pageSize - 1) & ~(pageSize - 1);
+            mprotect(base + section.offset, (std::min)(size, image.data.size() - section.offset), protection);
+        }
+        return base;
+    }
+
+    double Milliseconds(std::int64_t ns) { return ns / 1e6; }
+
+    // Code hidden from the startup scan, restored later
+    struct Late
+    {
+        std::uint8_t* address = nullptr;
+        std::vector<std::uint8_t> original;
+    };
+
+    std::atomic<bool> bLateRestored = false;
+
+    Late HideSignature(std::uint8_t* base, const Image& image, const std::string& name)
+    {
+        Late late;
+        for (const auto& signature : Signature::All) {
+            if (name != signature.name)
+                continue;
+            auto hit = Scanner::Find(base, image.data.size(), signature.pattern);
+            if (!hit)
+                break;
+            late.address = const_cast<std::uint8_t*>(hit);
+            late.original.assign(hit, hit + signature.pattern.size);
+
+            DWORD oldProtect = 0;
+            VirtualProtect(late.address, late.original.size(), PAGE_EXECUTE_READWRITE, &oldProtect);
+            std::memset(late.address, 0xCC, late.original.size());
+            VirtualProtect(late.address, late.original.size(), oldProtect, &oldProtect);
+        }
+        return late;
+    }
+
+    void RestoreLater(const Late& late, int milliseconds)
+    {
+        std::thread([late, milliseconds] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+            DWORD oldProtect = 0;
+            VirtualProtect(late.address, late.original.size(), PAGE_EXECUTE_READWRITE, &oldProtect);
+            std::memcpy(late.address, late.original.data(), late.original.size());
+            VirtualProtect(late.address, late.original.size(), oldProtect, &oldProtect);
+            bLateRestored = true;
+            }).detach();
+    }
+
+    RunResult Run(const Image& image, const Options& options, bool bReport)
+    {
+        RunResult result;
+        std::uint8_t* base = MapImage(image);
+        if (!base) {
+            std::fprintf(stderr, "Couldn't map the image.\n");
+            std::_Exit(1);
+        }
+
+        // What DllMain and the loader would have set up
+        static int thisModuleMarker;
+        baseModule = base;
+        thisModule = &thisModuleMarker;
+        Platform::MainModule = base;
+        Platform::DesktopWidth = options.desktopWidth;
+        Platform::DesktopHeight = options.desktopHeight;
+        Platform::SetModulePath(base, options.work / (options.image.empty() ? std::filesystem::path("Synthetic.exe") : options.image.filename()));
+        Platform::SetModulePath(thisModule, options.work / (sFixName + ".asi"));
+
+        Late late;
+        if (!options.late.empty()) {
+            late = HideSignature(base, image, options.late);
+            if (!late.address) {
+                std::fprintf(stderr, "No signature named %s in the image.\n", options.late.c_str());
+                std::_Exit(1);
+            }
+        }
+
+        // Patch times are kept relative to the trace epoch, which was set before the image was built
+        std::int64_t iMainStart = Trace::Now();
+        auto begin = std::chrono::steady_clock::now();
+        if (late.address)
+            RestoreLater(late, options.lateAfter);
+        Main(nullptr);
+        result.mainMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        result.firstPatchMs = Milliseconds(iFirstPatchTime - iMainStart);
+        result.lastPatchMs = Milliseconds(iLastPatchTime - iMainStart);
+
+        // Patched once any byte around it differs from the image as built, after it was put back
+        if (late.address) {
+            std::size_t rva = late.address - base;
+            std::size_t from = rva >= 0x20 ? rva - 0x20 : 0;
+            std::size_t to = (std::min)(rva + late.original.size() + 0x20, image.data.size());
+            auto deadline = begin + std::chrono::seconds(30);
+            while (result.lateMs < 0.0 && std::chrono::steady_clock::now() < deadline) {
+                for (std::size_t i = from; i < to && result.lateMs < 0.0 && bLateRestored; ++i) {
+                    if (base[i] != image.data[i])
+                        result.lateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (result.lateMs < 0.0)
+                ++result.unpatched;
+        }
+
+        for (const auto& entry : Scans.Entries()) {
+            std::size_t changed = 0;
+            std::size_t rva = 0;
+            if (entry.result.address) {
+                rva = entry.result.address - base;
+                std::size_t from = rva >= 0x20 ? rva - 0x20 : 0;
+                std::size_t to = (std::min)(rva + entry.pattern.size + 0x20, image.data.size());
+                for (std::size_t i = from; i < to; ++i)
+                    changed += base[i] != image.data[i];
+            }
+            if (!changed)
+                ++result.unpatched;
+            if (bReport) {
+                if (entry.result.address)
+                    std::printf("  %-24s  +%-8zx  %zu bytes changed\n", entry.name.c_str(), rva, changed);
+                else
+                    std::printf("  %-24s  not found\n", entry.name.c_str());
+            }
+        }
+
+        // The child ends with _Exit, so whatever the background threads logged last has to be flushed here
+        DllMain(thisModule, DLL_PROCESS_DETACH, nullptr);
+        logger->flush();
+        spdlog::shutdown();
+        return result;
+    }
+
+    bool ParseDesktop(const char* text, Options& options)
+    {
+        unsigned int width = 0, height = 0;
+        if (std::sscanf(text, "%ux%u", &width, &height) != 2 || !width || !height)
+            return false;
+        options.desktopWidth = width;
+        options.desktopHeight = height;
+        return true;
+    }
+
+    void Usage()
+    {
+        std::fprintf(stderr, "Usage: Harness [--image <executable> | --synthetic] [--config SotDFix.ini] [--desktop 3440x1440] [--runs 5] [--work <directory>] [--keep-cache]\n"
+            "               [--late <signature> [--late-after 500]]\n");
+    }
+
+    void PrintStat(const char* name, std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        std::printf("%-22s  min %8.2f ms  median %8.2f ms  max %8.2f ms\n", name, values.front(), values[values.size() / 2], values.back());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (arg == "--synthetic")
+            options.image.clear();
+        else if (arg == "--keep-cache")
+            options.bKeepCache = true;
+        else if (arg == "--image" && bHasValue)
+            options.image = argv[++i];
+        else if (arg == "--config" && bHasValue)
+            options.config = argv[++i];
+        else if (arg == "--work" && bHasValue)
+            options.work = argv[++i];
+        else if (arg == "--late" && bHasValue)
+            options.late = argv[++i];
+        else if (arg == "--late-after" && bHasValue)
+            options.lateAfter = (std::max)(0, std::atoi(argv[++i]));
+        else if (arg == "--runs" && bHasValue)
+            options.runs = (std::max)(1, std::atoi(argv[++i]));
+        else if (arg == "--desktop" && bHasValue && ParseDesktop(argv[i + 1], options))
+            ++i;
+        else {
+            Usage();
+            return 1;
+        }
+    }
+
+    Image image;
+    if (options.image.empty()) {
+        image = BuildSyntheticImage();
+    }
+    else if (std::string error; !LoadImage(options.image, image, error)) {
+        std::fprintf(stderr, "%s: %s\n", options.image.string().c_str(), error.c_str());
+        return 1;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.work, ec);
+    if (!std::filesystem::copy_file(options.config, options.work / sConfigFile, std::filesystem::copy_options::overwrite_existing, ec)) {
+        std::fprintf(stderr, "Couldn't copy %s to %s.\n", options.config.string().c_str(), options.work.string().c_str());
+        return 1;
+    }
+
+    std::printf("Harness: %s, %u x %u desktop, %d runs, work directory %s\n\n", options.image.empty() ? "synthetic image" : options.image.string().c_str(),
+        options.desktopWidth, options.desktopHeight, options.runs, options.work.string().c_str());
+    if (!RealDecoder())
+        std::printf("The linked decoder isn't Zydis, timings are not representative. Build against external/safetyhook/Zydis.c.\n\n");
+
+    std::vector<double> mainMs, firstPatchMs, lastPatchMs, lateMs;
+    bool bFailed = false;
+    for (int run = 0; run < options.runs; ++run) {
+        if (!options.bKeepCache)
+            std::filesystem::remove(options.work / sScanCacheFile, ec);
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            std::fprintf(stderr, "pipe() failed.\n");
+            return 1;
+        }
+        std::fflush(stdout);
+
+        // The fix's globals only survive one startup, so each run gets its own process
+        pid_t child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            RunResult result = Run(image, options, run == 0);
+            std::fflush(stdout);
+            bool bWritten = write(fds[1], &result, sizeof(result)) == sizeof(result);
+            std::_Exit(bWritten ? 0 : 1);
+        }
+        close(fds[1]);
+
+        RunResult result;
+        bool bRead = child > 0 && read(fds[0], &result, sizeof(result)) == sizeof(result);
+        close(fds[0]);
+        int status = 0;
+        if (child > 0)
+            waitpid(child, &status, 0);
+
+        if (!bRead || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::printf("Run %d failed (%s %d), see %s\n", run + 1, WIFSIGNALED(status) ? "signal" : "exit code",
+                WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status), (options.work / sLogFile).string().c_str());
+            bFailed = true;
+            continue;
+        }
+        if (result.unpatched)
+            bFailed = true;
+        mainMs.push_back(result.mainMs);
+        firstPatchMs.push_back(result.firstPatchMs);
+        lastPatchMs.push_back(result.lastPatchMs);
+        if (result.lateMs >= 0.0)
+            lateMs.push_back(result.lateMs);
+    }
+
+    if (!mainMs.empty()) {
+        std::printf("\n");
+        PrintStat("Main()", mainMs);
+        PrintStat("First patch live", firstPatchMs);
+        PrintStat("All patches live", lastPatchMs);
+        if (!lateMs.empty())
+            PrintStat("Late signature live", lateMs);
+    }
+    std::printf("\nLog: %s\n", (options.work / sLogFile).string().c_str());
+    return bFailed ? 2 : 0;
+}
@@ -0,0 +1,254 @@
+// LODTrace: feeds LOD::Governor simulated load traces and checks how its factor behaves.
+//
+// Builds without the Windows SDK, the game or the rest of the fix:
+//   g++ -std=c++23 -O2 -Isrc tools/LODTrace.cpp -o LODTrace
+//
+// Usage:
+//   LODTrace [--csv trace.csv]
+//
+// The simulated game renders a frame in a fixed cost plus a detail cost. The detail cost is full at the minimum
+// factor and falls to nothing at the maximum, linearly in log2 of the factor, with a few percent of deterministic
+// jitter on every frame. Traces, all against a 60 fps target:
+//   - steady load that some factor in range can hold: the factor converges and holds inside the hysteresis band
+//   - light load: the factor settles at the minimum (most detail)
+//   - heavy load: the factor settles at the maximum and never goes past it
+//   - a step change to a busier scene and back: the factor follows both ways and settles again
+//   - the steady trace with a hitch every couple of seconds: hitches leave the factor and state untouched
+// Every trace checks the factor stays within its bounds on every frame and, once settled, stops reversing
+// direction. --csv writes every frame of every trace for plotting. Exits with 2 if any check failed.
+
+#include "lodgovernor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr float TargetFrameTime = 1000.00f / 60.00f;
+
+    struct Load
+    {
+        float fFixed;   // ms at any factor
+        float fDetail;  // ms at the minimum factor, nothing at the maximum
+    };
+
+    struct Frame
+    {
+        float fFrameTime;
+        float fFactor;
+        LOD::Governor::State state;
+    };
+
+    struct Trace
+    {
+        const char* name;
+        std::vector<Frame> frames;
+    };
+
+    // Deterministic jitter in [-amount, amount]
+    class Jitter
+    {
+    public:
+        explicit Jitter(std::uint32_t seed) : m_state(seed) {}
+
+        float Next(float amount)
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return ((m_state >> 8) / float(1u << 24) * 2.00f - 1.00f) * amount;
+        }
+
+    private:
+        std::uint32_t m_state;
+    };
+
+    float FrameTime(const Load& load, float fFactor, const LOD::GovernorConfig& config)
+    {
+        float fDetail = 1.00f - log2f(fFactor / config.fMinFactor) / log2f(config.fMaxFactor / config.fMinFactor);
+        return load.fFixed + load.fDetail * std::clamp(fDetail, 0.00f, 1.00f);
+    }
+
+    LOD::GovernorConfig Config()
+    {
+        LOD::GovernorConfig config;
+        config.fTargetFrameTime = TargetFrameTime;
+        return config;
+    }
+
+    // "load" gives the load for a frame, "hitch" whether that frame is a hitch instead
+    template<typename LoadFn, typename HitchFn>
+    Trace Simulate(const char* name, int frames, LoadFn load, HitchFn hitch)
+    {
+        auto config = Config();
+        LOD::Governor governor(config);
+        Jitter jitter(1);
+        Trace trace{ name, {} };
+        trace.frames.reserve(frames);
+
+        for (int i = 0; i < frames; ++i) {
+            float fFrameTime = hitch(i) ? 40 * TargetFrameTime : FrameTime(load(i), governor.Factor(), config) * (1.00f + jitter.Next(0.03f));
+            governor.Update(fFrameTime);
+            trace.frames.push_back({ fFrameTime, governor.Factor(), governor.GetState() });
+        }
+        return trace;
+    }
+
+    template<typename LoadFn>
+    Trace Simulate(const char* name, int frames, LoadFn load)
+    {
+        return Simulate(name, frames, load, [](int) { return false; });
+    }
+
+    bool bAllPassed = true;
+
+    void Check(const Trace& trace, const char* what, bool bPassed)
+    {
+        std::printf("%-14s %-44s  %s\n", trace.name, what, bPassed ? "ok" : "FAILED");
+        bAllPassed &= bPassed;
+    }
+
+    bool InBounds(const Trace& trace)
+    {
+        auto config = Config();
+        return std::all_of(trace.frames.begin(), trace.frames.end(), [&](const Frame& frame) { return frame.fFactor >= config.fMinFactor && frame.fFactor <= config.fMaxFactor; });
+    }
+
+    // Times the factor switched between rising and falling in [begin, end)
+    int Reversals(const Trace& trace, std::size_t begin, std::size_t end)
+    {
+        int reversals = 0;
+        int direction = 0;
+        for (std::size_t i = (std::max<std::size_t>)(begin, 1); i < end; ++i) {
+            float fDelta = trace.frames[i].fFactor - trace.frames[i - 1].fFactor;
+            int current = fDelta > 0.00f ? 1 : fDelta < 0.00f ? -1 : 0;
+            if (current && direction && current != direction)
+                ++reversals;
+            if (current)
+                direction = current;
+        }
+        return reversals;
+    }
+
+    // Average frame time over [begin, end), hitches excluded
+    float Average(const Trace& trace, std::size_t begin, std::size_t end)
+    {
+        float fSum = 0.00f;
+        int count = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            if (trace.frames[i].fFrameTime > 10 * TargetFrameTime)
+                continue;
+            fSum += trace.frames[i].fFrameTime;
+            ++count;
+        }
+        return count ? fSum / count : 0.00f;
+    }
+
+    void Summary(const Trace& trace)
+    {
+        const Frame& last = trace.frames.back();
+        std::printf("%-14s factor %.4f, last 10 s average %.2f ms, %d reversals\n", trace.name, last.fFactor,
+            Average(trace, trace.frames.size() - 600, trace.frames.size()), Reversals(trace, 0, trace.frames.size()));
+    }
+
+    bool Settled(const Trace& trace, std::size_t from)
+    {
+        return Reversals(trace, from, trace.frames.size()) <= 1;
+    }
+
+    bool OnTarget(const Trace& trace, std::size_t begin, std::size_t end)
+    {
+        float fBand = TargetFrameTime * Config().fHysteresis;
+        return std::fabs(Average(trace, begin, end) - TargetFrameTime) <= fBand;
+    }
+
+    void WriteCsv(const std::string& path, const std::vector<Trace>& traces)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::fprintf(stderr, "Couldn't open %s\n", path.c_str());
+            bAllPassed = false;
+            return;
+        }
+        std::fprintf(file, "trace,frame,frame_time_ms,factor,state\n");
+        for (const auto& trace : traces) {
+            for (std::size_t i = 0; i < trace.frames.size(); ++i)
+                std::fprintf(file, "%s,%zu,%.3f,%.6f,%d\n", trace.name, i, trace.frames[i].fFrameTime, trace.frames[i].fFactor, (int)trace.frames[i].state);
+        }
+        std::fclose(file);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string sCsv;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--csv") && i + 1 < argc) {
+            sCsv = argv[++i];
+        }
+        else {
+            std::fprintf(stderr, "Usage: LODTrace [--csv trace.csv]\n");
+            return 1;
+        }
+    }
+
+    // Two minutes at roughly 60 fps
+    constexpr int Frames = 7200;
+    const Load steady{ 10.00f, 12.00f };
+    const Load light{ 6.00f, 8.00f };
+    const Load heavy{ 20.00f, 20.00f };   // Too slow even with the least detail
+    auto config = Config();
+    std::vector<Trace> traces;
+    traces.reserve(5);  // The checks keep references
+
+    // Holds somewhere in the middle of the range
+    traces.push_back(Simulate("steady", Frames, [&](int) { return steady; }));
+    const Trace& steadyTrace = traces.back();
+    Check(steadyTrace, "factor stays within its bounds", InBounds(steadyTrace));
+    Check(steadyTrace, "average settles inside the band", OnTarget(steadyTrace, Frames / 2, Frames));
+    Check(steadyTrace, "factor stops reversing", Settled(steadyTrace, Frames / 2));
+    Check(steadyTrace, "factor is off the bounds", steadyTrace.frames.back().fFactor > config.fMinFactor && steadyTrace.frames.back().fFactor < config.fMaxFactor);
+
+    traces.push_back(Simulate("light", Frames, [&](int) { return light; }));
+    const Trace& lightTrace = traces.back();
+    Check(lightTrace, "factor stays within its bounds", InBounds(lightTrace));
+    Check(lightTrace, "factor settles at the minimum", lightTrace.frames.back().fFactor == config.fMinFactor && Settled(lightTrace, Frames / 2));
+
+    traces.push_back(Simulate("heavy", Frames, [&](int) { return heavy; }));
+    const Trace& heavyTrace = traces.back();
+    Check(heavyTrace, "factor stays within its bounds", InBounds(heavyTrace));
+    Check(heavyTrace, "factor settles at the maximum", heavyTrace.frames.back().fFactor == config.fMaxFactor && Settled(heavyTrace, Frames / 2));
+
+    // Steady, then a minute of a heavier scene that can still be held, then back
+    const Load busy{ 10.00f, 18.00f };
+    traces.push_back(Simulate("step", 3 * Frames, [&](int i) { return i >= Frames && i < 2 * Frames ? busy : steady; }));
+    const Trace& stepTrace = traces.back();
+    Check(stepTrace, "factor stays within its bounds", InBounds(stepTrace));
+    Check(stepTrace, "factor rises with the load", stepTrace.frames[2 * Frames - 1].fFactor > stepTrace.frames[Frames - 1].fFactor);
+    Check(stepTrace, "on target again after the step up", OnTarget(stepTrace, Frames + Frames / 2, 2 * Frames) && Settled(stepTrace, Frames + Frames / 2) && Reversals(stepTrace, Frames + Frames / 2, 2 * Frames) <= 1);
+    Check(stepTrace, "factor falls once the load drops", stepTrace.frames.back().fFactor < stepTrace.frames[2 * Frames - 1].fFactor);
+    Check(stepTrace, "on target again after the step down", OnTarget(stepTrace, 2 * Frames + Frames / 2, 3 * Frames) && Settled(stepTrace, 2 * Frames + Frames / 2));
+
+    // A 670 ms hitch every 150 frames
+    traces.push_back(Simulate("hitches", Frames, [&](int) { return steady; }, [](int i) { return i % 150 == 149; }));
+    const Trace& hitchTrace = traces.back();
+    Check(hitchTrace, "factor stays within its bounds", InBounds(hitchTrace));
+    bool bUnchanged = true;
+    for (std::size_t i = 1; i < hitchTrace.frames.size(); ++i) {
+        if (hitchTrace.frames[i].fFrameTime > 10 * TargetFrameTime)
+            bUnchanged &= hitchTrace.frames[i].fFactor == hitchTrace.frames[i - 1].fFactor && hitchTrace.frames[i].state == hitchTrace.frames[i - 1].state;
+    }
+    Check(hitchTrace, "hitches don't move the factor", bUnchanged);
+    Check(hitchTrace, "average settles inside the band", OnTarget(hitchTrace, Frames / 2, Frames) && Settled(hitchTrace, Frames / 2));
+
+    std::printf("\n");
+    for (const auto& trace : traces)
+        Summary(trace);
+
+    if (!sCsv.empty())
+        WriteCsv(sCsv, traces);
+    return bAllPassed ? 0 : 2;
+}
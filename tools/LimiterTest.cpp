@@ -0,0 +1,224 @@
+// LimiterTest: drives FrameLimiter::Limiter with a simulated clock and checks the schedule it produces.
+//
+// Builds without the Windows SDK, the game or the rest of the fix:
+//   g++ -std=c++23 -O2 -Isrc tools/LimiterTest.cpp -o LimiterTest
+//
+// Usage:
+//   LimiterTest
+//
+// Time only moves when the simulated game does work, sleeps or spins, so every run is exact and repeatable. The game
+// side is a loop of "work for n ms, then Wait()". Checked:
+//   - steady load: each frame is released on its deadline, one interval apart
+//   - oversleeping: a sleep that overshoots the deadline is paid back on the next frame, nothing accumulates
+//   - a stall longer than a frame: the schedule re-anchors at the stall instead of rushing to catch up
+//   - Reset(), as when a movie plays: the next frame is released at once and the schedule starts over from it
+//   - no target: Wait() never sleeps
+// Prints one line per check and exits with 2 if any failed.
+
+#include "framelimiter.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using ns = std::chrono::nanoseconds;
+
+    // Shared by the clock and the sleeper
+    struct Simulation
+    {
+        ns now = 1s;
+        ns oversleep = 0ns;         // Added to a sleep
+        int oversleepEvery = 0;     // Only every nth sleep oversleeps, 0 for all of them
+        int sleeps = 0;
+        int spins = 0;
+    };
+
+    constexpr ns SpinStep = 10us;
+
+    struct FakeClock
+    {
+        using duration = ns;
+        using time_point = std::chrono::time_point<std::chrono::steady_clock, ns>;
+
+        Simulation* simulation = nullptr;
+
+        time_point Now() const { return time_point(simulation->now); }
+    };
+
+    struct FakeSleeper
+    {
+        Simulation* simulation = nullptr;
+
+        void Sleep(ns duration)
+        {
+            ++simulation->sleeps;
+            bool bOversleep = !simulation->oversleepEvery || simulation->sleeps % simulation->oversleepEvery == 0;
+            simulation->now += duration + (bOversleep ? simulation->oversleep : 0ns);
+        }
+
+        void Spin()
+        {
+            ++simulation->spins;
+            simulation->now += SpinStep;
+        }
+
+        ns Slack() const { return 1500us; }
+    };
+
+    using Limiter = FrameLimiter::Limiter<FakeClock, FakeSleeper>;
+
+    struct Run
+    {
+        Simulation simulation;
+        Limiter limiter;
+
+        explicit Run(double fps) : limiter(FakeClock{ &simulation }, FakeSleeper{ &simulation })
+        {
+            limiter.SetTarget(fps);
+        }
+
+        // Works for "work", then waits. Returns when the frame was released.
+        ns Frame(ns work)
+        {
+            simulation.now += work;
+            limiter.Wait();
+            return simulation.now;
+        }
+    };
+
+    bool bAllPassed = true;
+
+    bool Check(const char* name, bool bPassed, const char* detail = "")
+    {
+        std::printf("%-42s  %s%s%s\n", name, bPassed ? "ok" : "FAILED", *detail ? "  " : "", detail);
+        bAllPassed &= bPassed;
+        return bPassed;
+    }
+
+    // Releases "frames" frames after the first and returns their release times
+    std::vector<ns> Frames(Run& run, int frames, ns work)
+    {
+        std::vector<ns> releases;
+        for (int i = 0; i < frames; ++i)
+            releases.push_back(run.Frame(work));
+        return releases;
+    }
+
+    bool Within(ns value, ns expected, ns tolerance)
+    {
+        return value >= expected - tolerance && value <= expected + tolerance;
+    }
+
+    void SteadyLoad()
+    {
+        Run run(100.0);
+        ns start = run.Frame(5ms);
+        auto releases = Frames(run, 200, 5ms);
+
+        bool bOnTime = true;
+        for (std::size_t i = 0; i < releases.size(); ++i)
+            bOnTime &= Within(releases[i], start + 10ms * (i + 1), SpinStep);
+        Check("Steady load is released on each deadline", bOnTime);
+        Check("Steady load sleeps rather than spins", run.simulation.sleeps == 200 && run.simulation.spins <= 200 * (1500us / SpinStep + 1));
+    }
+
+    void Oversleep()
+    {
+        // Every fourth sleep runs 3 ms long, twice the slack, so that frame is released 1.5 ms late
+        Run run(100.0);
+        run.simulation.oversleep = 3ms;
+        run.simulation.oversleepEvery = 4;
+        ns start = run.Frame(5ms);
+        auto releases = Frames(run, 400, 5ms);
+
+        // A late frame may be late by the overshoot, the frame after it must be back on the original schedule
+        bool bNoDrift = true;
+        int late = 0;
+        for (std::size_t i = 0; i < releases.size(); ++i) {
+            ns deadline = start + 10ms * (i + 1);
+            if (releases[i] > deadline + SpinStep) {
+                ++late;
+                bNoDrift &= releases[i] <= deadline + 1500us + SpinStep;
+            }
+            else {
+                bNoDrift &= releases[i] >= deadline;
+            }
+        }
+        char detail[64];
+        std::snprintf(detail, sizeof(detail), "%d late frames, last at +%.3f ms", late, (releases.back() - start - 10ms * releases.size()).count() / 1e6);
+        Check("Oversleeping doesn't accumulate", bNoDrift && late == 100 && Within(releases.back(), start + 10ms * releases.size(), 1500us + SpinStep), detail);
+    }
+
+    void Stall()
+    {
+        Run run(100.0);
+        Frames(run, 10, 5ms);
+
+        // A loading hitch: 50 ms of work, five frames' worth
+        ns stalled = run.Frame(50ms);
+        auto releases = Frames(run, 10, 1ms);
+
+        bool bNoCatchUp = true;
+        for (std::size_t i = 0; i < releases.size(); ++i)
+            bNoCatchUp &= Within(releases[i], stalled + 10ms * (i + 1), SpinStep);
+        Check("A stall re-anchors the schedule", bNoCatchUp);
+
+        // Up to one frame behind is still paid back
+        Run slow(100.0);
+        ns start = slow.Frame(5ms);
+        ns late = slow.Frame(15ms);
+        ns next = slow.Frame(1ms);
+        Check("A short overrun is paid back", late == start + 15ms && Within(next, start + 20ms, SpinStep));
+    }
+
+    void MovieReset()
+    {
+        Run run(100.0);
+        Frames(run, 10, 5ms);
+
+        // While a movie plays the game paces itself and the limiter is reset every frame
+        for (int i = 0; i < 30; ++i) {
+            run.simulation.now += 33ms;
+            run.limiter.Reset();
+        }
+
+        int sleeps = run.simulation.sleeps;
+        ns resumed = run.Frame(2ms);
+        bool bImmediate = run.simulation.sleeps == sleeps;
+        auto releases = Frames(run, 10, 2ms);
+
+        bool bFresh = true;
+        for (std::size_t i = 0; i < releases.size(); ++i)
+            bFresh &= Within(releases[i], resumed + 10ms * (i + 1), SpinStep);
+        Check("After a reset the first frame is released", bImmediate);
+        Check("After a reset the schedule starts over", bFresh);
+    }
+
+    void Unlimited()
+    {
+        Run run(0.0);
+        ns start = run.simulation.now;
+        Frames(run, 100, 1ms);
+        Check("No target never waits", run.simulation.sleeps == 0 && run.simulation.spins == 0 && run.simulation.now == start + 100ms);
+
+        // Changing the target starts a new schedule
+        run.limiter.SetTarget(50.0);
+        ns first = run.Frame(1ms);
+        ns second = run.Frame(1ms);
+        Check("A new target takes effect", Within(second, first + 20ms, SpinStep));
+    }
+}
+
+int main()
+{
+    SteadyLoad();
+    Oversleep();
+    Stall();
+    MovieReset();
+    Unlimited();
+    return bAllPassed ? 0 : 2;
+}
@@ -0,0 +1,475 @@
+// ScanBench: pattern scanner benchmark against synthetic PE images.
+//
+// Builds without the Windows SDK, the game or the rest of the fix:
+//   g++ -std=c++23 -O2 -pthread -Isrc tools/ScanBench.cpp -o ScanBench
+//   clang++ -std=c++23 -O2 -pthread -Isrc tools/ScanBench.cpp -o ScanBench
+//
+// Usage:
+//   ScanBench [--sizes 16,64,256,512] [--threads 1,2,4,8] [--repeat 3] [--near-misses 1024] [--seed 1] [--no-baseline]
+//
+// Each image is a PE32+ layout with .text, .rdata and .data sections filled with byte streams shaped like x64 code
+// and data. Every signature from signatures.hpp is planted once in .text at a fixed fraction of its size, preceded by
+// near misses: copies that only differ in their last non-anchor byte, the worst case for a candidate check.
+//
+// Reported:
+//   - time to first match per signature and implementation on one thread, including the original byte loop the fix
+//     shipped with ("Baseline")
+//   - throughput of the single-pass multi-signature scan per kernel and thread count
+//   - the same set scanned one signature at a time, for comparison
+// Times are the best of --repeat runs. Both GB/s columns are .text bytes over wall time, so the per-signature one
+// counts each byte once however many signatures read it. Any scan that returns something other than the planted
+// address is flagged.
+
+#include "scanner.hpp"
+#include "signatures.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::vector<std::size_t> sizes = { 16, 64, 256, 512 };
+        std::vector<unsigned> threads;
+        int repeat = 3;
+        std::size_t nearMisses = 1024;
+        std::uint64_t seed = 1;
+        bool baseline = true;
+    };
+
+    // xorshift64*, fast enough to fill half a gigabyte without dominating the run
+    struct Random
+    {
+        std::uint64_t state;
+
+        std::uint64_t Next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1DULL;
+        }
+
+        std::uint32_t Below(std::uint32_t bound) { return static_cast<std::uint32_t>(Next() % bound); }
+        std::uint8_t Byte() { return static_cast<std::uint8_t>(Next() >> 56); }
+    };
+
+    class Writer
+    {
+    public:
+        Writer(std::uint8_t* data, std::size_t size) : m_data(data), m_size(size) {}
+
+        bool Full(std::size_t reserve = 16) const { return m_offset + reserve > m_size; }
+        void Put(std::uint8_t value) { m_data[m_offset++] = value; }
+        void Put(std::initializer_list<std::uint8_t> values) { for (auto value : values) Put(value); }
+
+        void Put32(std::uint32_t value)
+        {
+            std::memcpy(m_data + m_offset, &value, 4);
+            m_offset += 4;
+        }
+
+        void Pad(std::uint8_t value, std::size_t alignment)
+        {
+            while (m_offset % alignment && m_offset < m_size)
+                Put(value);
+        }
+
+        void Fill(std::uint8_t value) { std::memset(m_data + m_offset, value, m_size - m_offset); m_offset = m_size; }
+
+    private:
+        std::uint8_t* m_data;
+        std::size_t m_size;
+        std::size_t m_offset = 0;
+    };
+
+    std::uint8_t ModRM(Random& random) { return static_cast<std::uint8_t>(0x40 | random.Below(0x40)); }
+    std::uint32_t Rel32(Random& random) { return static_cast<std::uint32_t>(static_cast<std::int32_t>(random.Below(0x200000)) - 0x100000); }
+
+    // Instruction mix loosely following an MSVC x64 build: REX.W movs and leas, calls, VEX and SSE scalar float ops,
+    // short and near branches, and functions padded to 16 bytes with int3.
+    void FillCode(std::uint8_t* data, std::size_t size, Random& random)
+    {
+        Writer out(data, size);
+        std::uint32_t untilReturn = 20 + random.Below(60);
+
+        while (!out.Full()) {
+            if (--untilReturn == 0) {
+                out.Put(0xC3);
+                out.Pad(0xCC, 16);
+                untilReturn = 20 + random.Below(60);
+                continue;
+            }
+
+            switch (random.Below(20)) {
+            case 0: case 1: case 2: out.Put({ 0x48, 0x8B, ModRM(random), random.Byte() }); break;
+            case 3: case 4: out.Put({ 0x48, 0x89, ModRM(random), random.Byte() }); break;
+            case 5: out.Put({ 0x48, 0x8D, static_cast<std::uint8_t>(0x05 + 8 * random.Below(8)) }); out.Put32(Rel32(random)); break;
+            case 6: case 7: out.Put(0xE8); out.Put32(Rel32(random)); break;
+            case 8: out.Put({ 0xF3, 0x0F, static_cast<std::uint8_t>(0x10 + random.Below(2)), ModRM(random), random.Byte() }); break;
+            case 9: out.Put({ 0xC5, static_cast<std::uint8_t>(0xF8 + random.Below(4)), static_cast<std::uint8_t>(0x58 + random.Below(8)), ModRM(random) }); break;
+            case 10: out.Put({ 0xC4, 0xC1, 0x7A, 0x10, ModRM(random), random.Byte() }); break;
+            case 11: out.Put({ static_cast<std::uint8_t>(0x74 + random.Below(2)), random.Byte() }); break;
+            case 12: out.Put({ 0x0F, static_cast<std::uint8_t>(0x84 + random.Below(2)) }); out.Put32(Rel32(random)); break;
+            case 13: out.Put({ 0x41, static_cast<std::uint8_t>(0x50 + random.Below(16)) }); break;
+            case 14: out.Put({ static_cast<std::uint8_t>(0x85 + 2 * random.Below(3)), static_cast<std::uint8_t>(0xC0 | random.Below(0x40)) }); break;
+            case 15: out.Put({ 0x4C, 0x8B, ModRM(random), random.Byte() }); break;
+            case 16: out.Put({ 0xFF, 0x15 }); out.Put32(Rel32(random)); break;
+            case 17: out.Put(static_cast<std::uint8_t>(0xB8 + random.Below(8))); out.Put32(random.Below(0x1000)); break;
+            case 18: out.Put({ 0x0F, 0x1F, 0x44, 0x00, 0x00 }); break;
+            default: out.Put({ 0x48, 0x83, static_cast<std::uint8_t>(0xC0 | random.Below(0x40)), static_cast<std::uint8_t>(random.Below(0x80)) }); break;
+            }
+        }
+        out.Fill(0xCC);
+    }
+
+    // Constants, pointers into the image, ASCII strings and zero runs
+    void FillData(std::uint8_t* data, std::size_t size, Random& random)
+    {
+        Writer out(data, size);
+
+        while (!out.Full(64)) {
+            switch (random.Below(6)) {
+            case 0: {
+                float value = static_cast<float>(random.Below(100000)) / 100.0f;
+                std::uint32_t bits;
+                std::memcpy(&bits, &value, 4);
+                out.Put32(bits);
+                break;
+            }
+            case 1: out.Put32(0x40001000 + random.Below(0x1000000)); out.Put32(0x00007FF6); break;
+            case 2: {
+                std::uint32_t length = 4 + random.Below(40);
+                for (std::uint32_t i = 0; i < length; ++i)
+                    out.Put(static_cast<std::uint8_t>(0x61 + random.Below(26)));
+                out.Put(0x00);
+                out.Pad(0x00, 8);
+                break;
+            }
+            case 3: out.Put32(random.Below(0x100)); break;
+            default: {
+                std::uint32_t length = 8 + random.Below(48);
+                for (std::uint32_t i = 0; i < length; ++i)
+                    out.Put(0x00);
+                break;
+            }
+            }
+        }
+        out.Fill(0x00);
+    }
+
+    template<typename T>
+    void Store(std::uint8_t* data, T value) { std::memcpy(data, &value, sizeof(T)); }
+
+    struct Image
+    {
+        std::unique_ptr<std::uint8_t[]> data;
+        std::size_t size = 0;
+        std::vector<Scanner::Region> text;
+        std::vector<std::size_t> planted;   // Offset of the real match of each signature
+    };
+
+    void WriteHeaders(std::uint8_t* image, std::size_t size, const Scanner::Region (&sections)[3])
+    {
+        static const char* names[] = { ".text", ".rdata", ".data" };
+        static const std::uint32_t characteristics[] = { 0x60000020, 0x40000040, 0xC0000040 };
+
+        std::memset(image, 0, 0x1000);
+        Store<std::uint16_t>(image, 0x5A4D);
+        Store<std::uint32_t>(image + 0x3C, 0x80);
+
+        auto nt = image + 0x80;
+        Store<std::uint32_t>(nt, 0x00004550);
+        Store<std::uint16_t>(nt + 0x4, 0x8664);
+        Store<std::uint16_t>(nt + 0x6, 3);
+        Store<std::uint16_t>(nt + 0x14, 0xF0);
+        Store<std::uint16_t>(nt + 0x18, 0x20B);
+        Store<std::uint32_t>(nt + 0x18 + 0x38, static_cast<std::uint32_t>(size));
+
+        auto section = nt + 0x18 + 0xF0;
+        for (int i = 0; i < 3; ++i, section += 0x28) {
+            std::memcpy(section, names[i], std::strlen(names[i]));
+            Store<std::uint32_t>(section + 0x8, static_cast<std::uint32_t>(sections[i].size));
+            Store<std::uint32_t>(section + 0xC, static_cast<std::uint32_t>(sections[i].offset));
+            Store<std::uint32_t>(section + 0x24, characteristics[i]);
+        }
+    }
+
+    // Concrete bytes for a signature, wildcards filled at random
+    void Materialise(std::uint8_t* out, const Scanner::PatternView& pattern, Random& random)
+    {
+        for (std::size_t i = 0; i < pattern.size; ++i)
+            out[i] = pattern.mask[i] ? pattern.bytes[i] : random.Byte();
+    }
+
+    // Last fixed byte that isn't an anchor, so candidate filters pass and the full compare fails as late as possible
+    std::size_t NearMissPosition(const Scanner::PatternView& pattern)
+    {
+        for (std::size_t i = pattern.size; i-- > 0;) {
+            if (pattern.mask[i] && i != pattern.anchor && i != pattern.anchor2)
+                return i;
+        }
+        return pattern.anchor;
+    }
+
+    Image BuildImage(std::size_t size, const Options& options)
+    {
+        Random random{ options.seed * 0x9E3779B97F4A7C15ULL + size };
+        Image image;
+        image.size = size;
+        image.data.reset(new std::uint8_t[size]);
+
+        std::size_t textSize = (size * 3 / 4) & ~std::size_t(0xFFF);
+        std::size_t rdataSize = (size * 3 / 20) & ~std::size_t(0xFFF);
+        const Scanner::Region sections[3] = {
+            { 0x1000, textSize - 0x1000 },
+            { textSize, rdataSize },
+            { textSize + rdataSize, size - textSize - rdataSize },
+        };
+
+        WriteHeaders(image.data.get(), size, sections);
+        FillCode(image.data.get() + sections[0].offset, sections[0].size, random);
+        FillData(image.data.get() + sections[1].offset, sections[1].size, random);
+        FillData(image.data.get() + sections[2].offset, sections[2].size, random);
+        image.text = Scanner::ExecutableRegions(image.data.get());
+
+        // 128 byte slots keep planted copies from overlapping each other
+        constexpr std::size_t slot = 128;
+        const std::size_t count = std::size(Signature::All);
+        std::unordered_set<std::size_t> used;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& pattern = Signature::All[i].pattern;
+            std::size_t offset = sections[0].offset + (sections[0].size * (i + 1) / (count + 1)) / slot * slot;
+            used.insert(offset / slot);
+            Materialise(image.data.get() + offset, pattern, random);
+            image.planted.push_back(offset);
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& pattern = Signature::All[i].pattern;
+            std::size_t position = NearMissPosition(pattern);
+            std::size_t firstSlot = sections[0].offset / slot;
+            std::size_t slots = (image.planted[i] - sections[0].offset) / slot;
+
+            for (std::size_t n = 0; n < options.nearMisses && slots > 1; ++n) {
+                std::size_t index = firstSlot + random.Next() % (slots - 1);
+                if (!used.insert(index).second)
+                    continue;
+                auto out = image.data.get() + index * slot;
+                Materialise(out, pattern, random);
+                out[position] = static_cast<std::uint8_t>(~pattern.bytes[position]);
+            }
+        }
+        return image;
+    }
+
+    // The scan the fix originally shipped with: a byte-by-byte compare over the whole image.
+    const std::uint8_t* BaselineFind(const std::uint8_t* image, const Scanner::PatternView& pattern)
+    {
+        std::vector<int> bytes;
+        for (std::size_t i = 0; i < pattern.size; ++i)
+            bytes.push_back(pattern.mask[i] ? pattern.bytes[i] : -1);
+
+        auto sizeOfImage = Scanner::ImageSize(image);
+        auto s = bytes.size();
+        auto d = bytes.data();
+
+        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
+            bool found = true;
+            for (auto j = 0ul; j < s; ++j) {
+                if (image[i + j] != d[j] && d[j] != -1) {
+                    found = false;
+                    break;
+                }
+            }
+            if (found)
+                return &image[i];
+        }
+        return nullptr;
+    }
+
+    template<typename Work>
+    double BestMs(int repeat, Work&& work)
+    {
+        double best = 1e300;
+        for (int i = 0; i < repeat; ++i) {
+            auto begin = std::chrono::steady_clock::now();
+            work();
+            best = (std::min)(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+        }
+        return best;
+    }
+
+    double GBps(std::size_t bytes, double ms) { return ms > 0.0 ? bytes / (ms * 1e6) : 0.0; }
+
+    std::vector<Scanner::Isa> SupportedIsas()
+    {
+        std::vector<Scanner::Isa> isas;
+        for (auto isa : { Scanner::Isa::Scalar, Scanner::Isa::SSE2, Scanner::Isa::AVX2 }) {
+            if (static_cast<int>(isa) <= static_cast<int>(Scanner::DetectIsa()))
+                isas.push_back(isa);
+        }
+        return isas;
+    }
+
+    int Run(const Image& image, const Options& options)
+    {
+        const auto base = image.data.get();
+        const auto isas = SupportedIsas();
+        const std::size_t count = std::size(Signature::All);
+        std::size_t textBytes = 0;
+        for (const auto& region : image.text)
+            textBytes += region.size;
+        int failures = 0;
+
+        auto check = [&](const char* what, std::size_t id, const std::uint8_t* found) {
+            if (found != base + image.planted[id]) {
+                std::printf("  MISMATCH: %s found %s at %zx, planted at %zx\n", what, Signature::All[id].name,
+                    found ? static_cast<std::size_t>(found - base) : 0, image.planted[id]);
+                ++failures;
+            }
+            };
+
+        std::printf("\nImage %zu MB (.text %zu MB, %zu near misses per signature)\n", image.size >> 20, textBytes >> 20, options.nearMisses);
+
+        // Time to first match, one thread
+        std::printf("\n  %-24s %12s", "ms to first match", "bytes");
+        if (options.baseline)
+            std::printf(" %10s", "Baseline");
+        for (auto isa : isas)
+            std::printf(" %10s", Scanner::IsaName(isa));
+        std::printf("\n");
+
+        Scanner::MaxThreads = 1;
+        for (std::size_t id = 0; id < count; ++id) {
+            const auto& pattern = Signature::All[id].pattern;
+            std::printf("  %-24s %12zu", Signature::All[id].name, image.planted[id] - image.text.front().offset);
+
+            if (options.baseline) {
+                const std::uint8_t* found = nullptr;
+                std::printf(" %10.2f", BestMs(options.repeat, [&] { found = BaselineFind(base, pattern); }));
+                check("Baseline", id, found);
+            }
+            for (auto isa : isas) {
+                Scanner::ForceIsa(isa);
+                const std::uint8_t* found = nullptr;
+                std::printf(" %10.2f", BestMs(options.repeat, [&] { found = Scanner::Find(base, image.text, pattern); }));
+                check(Scanner::IsaName(isa), id, found);
+            }
+            std::printf("\n");
+        }
+
+        // Whole .text sweeps: every signature in one pass vs one scan per signature
+        std::printf("\n  %-8s %8s %14s %10s %16s %10s\n", "Kernel", "Threads", "single pass ms", "GB/s", "per signature ms", "GB/s");
+        for (auto isa : isas) {
+            Scanner::ForceIsa(isa);
+            for (auto threads : options.threads) {
+                Scanner::MaxThreads = threads;
+
+                Scanner::MultiScanner scanner;
+                for (const auto& entry : Signature::All)
+                    scanner.Add(entry.name, entry.pattern);
+                auto checkScanner = [&] {
+                    for (std::size_t id = 0; id < count; ++id) {
+                        check("MultiScanner", id, scanner[id].address);
+                        if (scanner[id].count != 1) {
+                            std::printf("  MISMATCH: MultiScanner counted %zu matches of %s\n", scanner[id].count, Signature::All[id].name);
+                            ++failures;
+                        }
+                    }
+                    };
+
+                double multiMs = BestMs(options.repeat, [&] { scanner.Scan(base, image.text, image.text); });
+                checkScanner();
+
+                // The multi-pass equivalent has to see every match too, so it runs FindAll per region
+                double separateMs = BestMs(options.repeat, [&] {
+                    for (const auto& entry : Signature::All) {
+                        for (const auto& region : image.text)
+                            (void)Scanner::FindAll(base + region.offset, region.size, entry.pattern);
+                    }
+                    });
+
+                std::printf("  %-8s %8u %14.2f %10.2f %16.2f %10.2f\n", Scanner::IsaName(isa), threads,
+                    multiMs, GBps(textBytes, multiMs), separateMs, GBps(textBytes, separateMs));
+            }
+        }
+        Scanner::MaxThreads = 0;
+        Scanner::ForceIsa(Scanner::DetectIsa());
+        return failures;
+    }
+
+    template<typename T>
+    std::vector<T> ParseList(const char* text)
+    {
+        std::vector<T> values;
+        for (char* end = nullptr; *text; text = *end ? end + 1 : end) {
+            values.push_back(static_cast<T>(std::strtoull(text, &end, 10)));
+            if (end == text)
+                break;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue)
+            options.sizes = ParseList<std::size_t>(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threads = ParseList<unsigned>(argv[++i]);
+        else if (arg == "--repeat" && hasValue)
+            options.repeat = (std::max)(1, std::atoi(argv[++i]));
+        else if (arg == "--near-misses" && hasValue)
+            options.nearMisses = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && hasValue)
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--no-baseline")
+            options.baseline = false;
+        else {
+            std::printf("Usage: %s [--sizes 16,64,256,512] [--threads 1,2,4,8] [--repeat 3] [--near-misses 1024] [--seed 1] [--no-baseline]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.threads.empty()) {
+        unsigned cores = (std::max)(1u, std::thread::hardware_concurrency());
+        for (unsigned threads = 1; threads < cores; threads *= 2)
+            options.threads.push_back(threads);
+        options.threads.push_back(cores);
+    }
+
+    std::printf("ScanBench: %u hardware threads, best kernel %s, best of %d runs\n",
+        std::thread::hardware_concurrency(), Scanner::IsaName(Scanner::DetectIsa()), options.repeat);
+
+    int failures = 0;
+    for (auto megabytes : options.sizes) {
+        if (megabytes < 1 || megabytes > 3072) {
+            std::printf("Skipping %zu MB, images must be 1-3072 MB.\n", megabytes);
+            continue;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        auto image = BuildImage(megabytes << 20, options);
+        std::printf("\nGenerated %zu MB image in %.0f ms", megabytes, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+        failures += Run(image, options);
+    }
+
+    if (failures)
+        std::printf("\n%d scans returned the wrong address.\n", failures);
+    return failures ? 2 : 0;
+}
@@ -0,0 +1,291 @@
+// SigCheck: checks every signature of the fix against game executables on disk, without running the game.
+//
+// Zydis.c is the amalgamated C source of Zydis 4.0 that belongs next to Zydis.h in external/safetyhook. SotDFix.vcxproj
+// compiles the same file; take it from the safetyhook amalgamation Zydis.h came from. Build with:
+//   gcc -c -O2 -Iexternal/safetyhook external/safetyhook/Zydis.c -o Zydis.o
+//   g++ -std=c++23 -O2 -pthread -Isrc -Iexternal/safetyhook tools/SigCheck.cpp Zydis.o -o SigCheck
+//
+// Usage:
+//   SigCheck [--matches N] <executable or directory>...
+//
+// Each executable is mapped the way the loader would (headers and sections copied to their RVAs), then every
+// signature in signatures.hpp is found with the same single-pass scanner the DLL uses. For each signature the
+// RVA of the first match, the number of matches and the instruction decoded at the hit are printed. Directories
+// are searched recursively for .exe files so a whole set of builds can be triaged at once.
+//
+// Exit code: 0 if every signature matched exactly once in every executable, 2 if any was missing or ambiguous,
+// 1 if a file couldn't be read.
+
+#include "scanner.hpp"
+#include "signatures.hpp"
+
+#include <Zydis.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // An executable laid out at its RVAs, as it would be in memory after loading.
+    struct MappedImage
+    {
+        std::vector<std::uint8_t> data;
+        std::uint64_t imageBase = 0;
+        std::uint32_t timestamp = 0;
+        bool is64 = true;
+    };
+
+    template<typename T>
+    bool Read(const std::vector<std::uint8_t>& file, std::size_t offset, T& value)
+    {
+        if (offset > file.size() || file.size() - offset < sizeof(T))
+            return false;
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return true;
+    }
+
+    bool MapImage(const std::filesystem::path& path, MappedImage& image, std::string& error)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) {
+            error = "could not open file";
+            return false;
+        }
+        std::vector<std::uint8_t> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+        std::uint16_t mz = 0;
+        std::uint32_t ntOffset = 0;
+        std::uint32_t signature = 0;
+        if (!Read(file, 0, mz) || mz != 0x5A4D || !Read(file, 0x3C, ntOffset) || !Read(file, ntOffset, signature) || signature != 0x00004550) {
+            error = "not a PE file";
+            return false;
+        }
+
+        std::uint16_t numberOfSections = 0;
+        std::uint16_t sizeOfOptionalHeader = 0;
+        std::uint16_t magic = 0;
+        std::uint32_t sizeOfImage = 0;
+        std::uint32_t sizeOfHeaders = 0;
+        const std::size_t optionalHeader = ntOffset + 0x18;
+        if (!Read(file, ntOffset + 0x6, numberOfSections) || !Read(file, ntOffset + 0x8, image.timestamp) || !Read(file, ntOffset + 0x14, sizeOfOptionalHeader) ||
+            !Read(file, optionalHeader, magic) || !Read(file, optionalHeader + 0x38, sizeOfImage) || !Read(file, optionalHeader + 0x3C, sizeOfHeaders)) {
+            error = "truncated PE headers";
+            return false;
+        }
+
+        image.is64 = magic == 0x20B;
+        if (image.is64) {
+            Read(file, optionalHeader + 0x18, image.imageBase);
+        }
+        else {
+            std::uint32_t imageBase32 = 0;
+            Read(file, optionalHeader + 0x1C, imageBase32);
+            image.imageBase = imageBase32;
+        }
+
+        // The section table is read again from the mapped headers, so they have to fit
+        const std::size_t sectionTableEnd = optionalHeader + sizeOfOptionalHeader + numberOfSections * 0x28ull;
+        if (sizeOfImage < sectionTableEnd || sizeOfHeaders < sectionTableEnd) {
+            error = "SizeOfImage or SizeOfHeaders smaller than the headers";
+            return false;
+        }
+
+        image.data.assign(sizeOfImage, 0);
+        std::memcpy(image.data.data(), file.data(), (std::min<std::size_t>)({ sizeOfHeaders, sizeOfImage, file.size() }));
+
+        std::size_t sectionHeader = optionalHeader + sizeOfOptionalHeader;
+        for (std::uint16_t i = 0; i < numberOfSections; ++i, sectionHeader += 0x28) {
+            std::uint32_t virtualSize = 0, virtualAddress = 0, sizeOfRawData = 0, pointerToRawData = 0;
+            if (!Read(file, sectionHeader + 0x8, virtualSize) || !Read(file, sectionHeader + 0xC, virtualAddress) ||
+                !Read(file, sectionHeader + 0x10, sizeOfRawData) || !Read(file, sectionHeader + 0x14, pointerToRawData)) {
+                error = "truncated section table";
+                return false;
+            }
+
+            std::size_t size = virtualSize ? (std::min)(virtualSize, sizeOfRawData) : sizeOfRawData;
+            if (virtualAddress >= sizeOfImage || pointerToRawData >= file.size())
+                continue;
+            size = (std::min<std::size_t>)({ size, sizeOfImage - virtualAddress, file.size() - pointerToRawData });
+            std::memcpy(image.data.data() + virtualAddress, file.data() + pointerToRawData, size);
+        }
+        return true;
+    }
+
+    class Disassembler
+    {
+    public:
+        explicit Disassembler(bool is64)
+        {
+            ZydisDecoderInit(&m_decoder, is64 ? ZYDIS_MACHINE_MODE_LONG_64 : ZYDIS_MACHINE_MODE_LEGACY_32, is64 ? ZYDIS_STACK_WIDTH_64 : ZYDIS_STACK_WIDTH_32);
+            ZydisFormatterInit(&m_formatter, ZYDIS_FORMATTER_STYLE_INTEL);
+        }
+
+        std::string Decode(const std::uint8_t* code, std::size_t available, std::uint64_t address) const
+        {
+            ZydisDecodedInstruction instruction;
+            ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+            if (ZYAN_FAILED(ZydisDecoderDecodeFull(&m_decoder, code, available, &instruction, operands)))
+                return "(invalid instruction)";
+
+            char text[256];
+            if (ZYAN_FAILED(ZydisFormatterFormatInstruction(&m_formatter, &instruction, operands, instruction.operand_count_visible, text, sizeof(text), address, nullptr)))
+                return "(unformattable instruction)";
+            return text;
+        }
+
+    private:
+        ZydisDecoder m_decoder;
+        ZydisFormatter m_formatter;
+    };
+
+    double MsSince(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    struct FileResult
+    {
+        std::filesystem::path path;
+        bool read = false;
+        std::size_t unique = 0;
+    };
+
+    FileResult Check(const std::filesystem::path& path, std::size_t maxMatches)
+    {
+        FileResult fileResult{ path };
+        MappedImage image;
+        std::string error;
+
+        auto mapBegin = std::chrono::steady_clock::now();
+        if (!MapImage(path, image, error)) {
+            std::printf("%s: %s\n\n", path.string().c_str(), error.c_str());
+            return fileResult;
+        }
+        double mapMs = MsSince(mapBegin);
+        fileResult.read = true;
+
+        const auto base = image.data.data();
+        // Section headers come straight from the file, keep every read inside the mapped image
+        auto regions = Scanner::ExecutableRegions(base, image.data.size());
+        std::size_t codeBytes = 0;
+        for (const auto& region : regions)
+            codeBytes += region.size;
+
+        Scanner::MultiScanner scanner;
+        for (const auto& entry : Signature::All)
+            scanner.Add(entry.name, entry.pattern);
+
+        auto scanBegin = std::chrono::steady_clock::now();
+        scanner.Scan(base, regions, { { 0, image.data.size() } });
+        double scanMs = MsSince(scanBegin);
+
+        std::printf("%s\n", path.string().c_str());
+        std::printf("  Timestamp %08X, %s, image %.1f MB, code %.1f MB, mapped in %.1f ms, scanned in %.1f ms (%s)\n",
+            image.timestamp, image.is64 ? "PE32+" : "PE32", image.data.size() / 1048576.0, codeBytes / 1048576.0, mapMs, scanMs, Scanner::IsaName(Scanner::ActiveIsa()));
+
+        Disassembler disassembler(image.is64);
+        for (std::size_t id = 0; id < std::size(Signature::All); ++id) {
+            const auto& result = scanner[id];
+            const char* name = Signature::All[id].name;
+
+            if (!result.count) {
+                std::printf("  %-24s MISSING\n", name);
+                continue;
+            }
+
+            std::size_t rva = result.address - base;
+            std::string instruction = disassembler.Decode(result.address, image.data.size() - rva, image.imageBase + rva);
+            std::printf("  %-24s %08zX  %-10s %s\n", name, rva, result.count == 1 ? "unique" : (std::to_string(result.count) + " hits").c_str(), instruction.c_str());
+
+            if (result.count == 1) {
+                ++fileResult.unique;
+                continue;
+            }
+
+            // List where the other matches are, so the signature can be tightened
+            std::size_t listed = 0;
+            for (const auto& region : regions) {
+                if (listed >= maxMatches)
+                    break;
+                for (auto match : Scanner::FindAll(base + region.offset, region.size, Signature::All[id].pattern)) {
+                    if (listed >= maxMatches)
+                        break;
+                    ++listed;
+                    std::size_t matchRva = match - base;
+                    std::printf("  %-24s %08zX             %s\n", "", matchRva, disassembler.Decode(match, image.data.size() - matchRva, image.imageBase + matchRva).c_str());
+                }
+            }
+        }
+        std::printf("\n");
+        return fileResult;
+    }
+
+    bool IsExecutable(const std::filesystem::path& path)
+    {
+        auto extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension == ".exe";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t maxMatches = 8;
+    std::vector<std::filesystem::path> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--matches" && i + 1 < argc) {
+            maxMatches = std::strtoull(argv[++i], nullptr, 10);
+            continue;
+        }
+
+        std::error_code ec;
+        if (std::filesystem::is_directory(arg, ec)) {
+            std::vector<std::filesystem::path> found;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(arg, std::filesystem::directory_options::skip_permission_denied, ec)) {
+                if (entry.is_regular_file(ec) && IsExecutable(entry.path()))
+                    found.push_back(entry.path());
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        std::printf("Usage: %s [--matches N] <executable or directory>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<FileResult> results;
+    for (const auto& file : files)
+        results.push_back(Check(file, maxMatches));
+
+    bool bUnreadable = false;
+    bool bIncomplete = false;
+    if (results.size() > 1) {
+        std::printf("Summary\n");
+        for (const auto& result : results) {
+            if (result.read)
+                std::printf("  %zu/%zu unique  %s\n", result.unique, std::size(Signature::All), result.path.string().c_str());
+            else
+                std::printf("  unreadable  %s\n", result.path.string().c_str());
+        }
+    }
+    for (const auto& result : results) {
+        bUnreadable |= !result.read;
+        bIncomplete |= result.read && result.unique != std::size(Signature::All);
+    }
+    return bUnreadable ? 1 : (bIncomplete ? 2 : 0);
+}
@@ -0,0 +1,146 @@
+// TelemetryReader: attaches to the fix's shared memory telemetry block and prints live stats.
+//
+// Windows (Developer Command Prompt):
+//   cl /std:c++latest /EHsc /O2 /Isrc tools\TelemetryReader.cpp
+// Linux, against the harness:
+//   g++ -std=c++23 -O2 -Isrc tools/TelemetryReader.cpp -o TelemetryReader
+//
+// Usage:
+//   TelemetryReader [--interval ms] [--count N]
+//
+// Needs "[Telemetry] Enabled = true" in SotDFix.ini. Waits for the block to appear, then prints one line per interval
+// with the resolution, FOV and HUD values, LOD factor, frame pacing and the frames since the previous line, followed
+// by per-hook call counts when Hook Stats is enabled. If the game restarts the reader picks up the new session.
+// The block is mapped read-only; reading it never blocks the game.
+
+#include "telemetry.hpp"
+#include "frametimes.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        int interval = 1000;
+        long long count = 0;    // 0 for until interrupted
+    };
+
+    void Usage()
+    {
+        std::fprintf(stderr, "Usage: TelemetryReader [--interval ms] [--count N]\n");
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                Usage();
+                return false;
+            }
+            if (arg == "--interval")
+                options.interval = std::atoi(argv[++i]);
+            else if (arg == "--count")
+                options.count = std::atoll(argv[++i]);
+            else {
+                Usage();
+                return false;
+            }
+        }
+        options.interval = (std::max)(options.interval, 10);
+        return true;
+    }
+
+    const char* LODStateName(std::uint32_t state)
+    {
+        switch (static_cast<Telemetry::LODState>(state)) {
+        case Telemetry::LODState::Holding: return "holding";
+        case Telemetry::LODState::Raising: return "raising";
+        case Telemetry::LODState::Lowering: return "lowering";
+        default: return "?";
+        }
+    }
+
+    void PrintSession(const Telemetry::Block& block)
+    {
+        std::printf("Attached to %.16s %.16s in process %u, telemetry version %u\n", block.fixName, block.fixVersion, block.processId, block.version);
+    }
+
+    void PrintLine(const Telemetry::Reader& reader, const std::vector<float>& frameTimes)
+    {
+        const auto& block = reader.Get();
+        auto screen = reader.GetScreen();
+        std::printf("%dx%d aspect %.3f fov x%.3f hud %dx%d+%d+%d | lod %.4f %s | limit %.0f fps | %u patches %u hooks",
+            screen.resX, screen.resY, screen.aspectRatio, screen.fovScale, screen.hudWidth, screen.hudHeight, screen.hudWidthOffset, screen.hudHeightOffset,
+            block.lodFactor.load(std::memory_order_relaxed), LODStateName(block.lodState.load(std::memory_order_relaxed)),
+            block.frameLimit.load(std::memory_order_relaxed), block.patchesLive.load(std::memory_order_relaxed), block.hooksLive.load(std::memory_order_relaxed));
+
+        auto stats = FrameTimes::Summarise(frameTimes);
+        if (stats.frames)
+            std::printf(" | %zu frames, avg %.1f fps, 1%% low %.1f fps, max %.2f ms, %zu stutters", stats.frames, stats.avgFps, stats.low1Fps, stats.maxFrameTime, stats.stutters);
+        else
+            std::printf(" | no frames");
+        std::printf("\n");
+
+        auto hookCount = (std::min<std::size_t>)(block.hookCount.load(std::memory_order_acquire), Telemetry::MaxHooks);
+        for (std::size_t id = 0; id < hookCount; ++id) {
+            const auto& hook = block.hooks[id];
+            std::printf("  %-24.32s %12llu calls, p99 %.0f ns, max %.0f ns\n", hook.name, (unsigned long long)hook.calls.load(std::memory_order_relaxed),
+                hook.p99.load(std::memory_order_relaxed), hook.max.load(std::memory_order_relaxed));
+        }
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+        return 1;
+
+    Telemetry::Reader reader;
+    std::uint64_t frames = 0;
+    std::uint32_t processId = 0;
+    int stalled = 0;
+    bool bWaiting = false;
+    std::vector<float> frameTimes;
+
+    for (long long lines = 0; !options.count || lines < options.count;) {
+        // A block left behind by a session that ended can be replaced, reattach once frames stop coming
+        if (!reader.Valid() || stalled >= 2) {
+            if (!reader.Open(Telemetry::Name)) {
+                if (!bWaiting)
+                    std::printf("Waiting for SotDFix telemetry...\n");
+                bWaiting = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.interval));
+                continue;
+            }
+            bWaiting = false;
+            stalled = 0;
+            if (reader.Get().processId != processId) {
+                processId = reader.Get().processId;
+                frames = reader.Get().frames.load(std::memory_order_acquire);
+                PrintSession(reader.Get());
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.interval));
+        if (!reader.Valid())
+            continue;
+
+        frameTimes.clear();
+        auto next = reader.FramesSince(frames, frameTimes);
+        stalled = next == frames ? stalled + 1 : 0;
+        frames = next;
+        PrintLine(reader, frameTimes);
+        ++lines;
+    }
+    return 0;
+}